@@ -34,7 +34,7 @@ syntax keyword awitTodo contained TODO XXX TANDAANG GAWIN
 " Language Keywords
 syntax keyword awithOpKeywords contained at o
 syntax keyword awithLitKeywords contained mali tama null
-syntax keyword awithVarKeywords kilalanin nextgroup=awitIdentifier skipwhite
+syntax keyword awithVarKeywords kilalanin konst nextgroup=awitIdentifier skipwhite
 syntax keyword awitKeywords gawain nextgroup=awitIdentifier skipwhite
 syntax keyword awitKeywords gawin habang ibalik
 syntax keyword awitKeywords ipakita itigil ito ituloy kada
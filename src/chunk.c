@@ -12,16 +12,55 @@ void initChunk(Chunk* chunk) {
     chunk->lineCapacity = 0;
     chunk->lines = NULL;
     initValueArray(&chunk->constants);
+    chunk->switchCount = 0;
+    chunk->switchCapacity = 0;
+    chunk->switches = NULL;
+    chunk->callCount = 0;
+    chunk->callCapacity = 0;
+    chunk->calls = NULL;
+    chunk->inlinedCount = 0;
+    chunk->inlinedCapacity = 0;
+    chunk->inlined = NULL;
+    chunk->fallbacks = NULL;
 }
 
 void freeChunk(Chunk* chunk) {
     FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
     FREE_ARRAY(LineStart, chunk->lines, chunk->lineCapacity);
     freeValueArray(&chunk->constants);
+    for (int i = 0; i < chunk->switchCount; i++) {
+        SwitchTable* table = &chunk->switches[i];
+        FREE_ARRAY(int, table->offsets, table->offsetCount);
+        freeValueTable(&table->cases);
+    }
+    FREE_ARRAY(SwitchTable, chunk->switches, chunk->switchCapacity);
+    FREE_ARRAY(CallCache, chunk->calls, chunk->callCapacity);
+    FREE_ARRAY(InlinedCall, chunk->inlined, chunk->inlinedCapacity);
+    FREE_ARRAY(uint8_t, chunk->fallbacks, chunk->count);
     chunk->count = 0;
     initChunk(chunk);
 }
 
+// Releases the spare capacity left by GROW_CAPACITY once a chunk is done.
+void shrinkChunk(Chunk* chunk) {
+    chunk->code = GROW_ARRAY(uint8_t, chunk->code,
+        chunk->capacity, chunk->count);
+    chunk->capacity = chunk->count;
+
+    chunk->lines = GROW_ARRAY(LineStart, chunk->lines,
+        chunk->lineCapacity, chunk->lineCount);
+    chunk->lineCapacity = chunk->lineCount;
+
+    ValueArray* constants = &chunk->constants;
+    constants->values = GROW_ARRAY(Value, constants->values,
+        constants->capacity, constants->count);
+    constants->capacity = constants->count;
+
+    chunk->calls = GROW_ARRAY(CallCache, chunk->calls,
+        chunk->callCapacity, chunk->callCount);
+    chunk->callCapacity = chunk->callCount;
+}
+
 void writeChunk(Chunk* chunk, uint8_t byte, int line) {
     if (chunk->capacity < chunk->count + 1) {
         int oldCapacity = chunk->capacity;
@@ -52,7 +91,7 @@ void writeChunk(Chunk* chunk, uint8_t byte, int line) {
 
 void writeConstant(Chunk* chunk, Value value, int line) {
     int index = addConstant(chunk, value);
-    if (index < UINT8_MAX) {
+    if (index <= UINT8_MAX) {
         writeChunk(chunk, OP_CONSTANT, line);
         writeChunk(chunk, index, line);
     } else {
@@ -70,6 +109,54 @@ int addConstant(Chunk* chunk, Value value) {
     return chunk->constants.count - 1;
 }
 
+int addSwitchTable(Chunk* chunk) {
+    if (chunk->switchCapacity < chunk->switchCount + 1) {
+        int oldCapacity = chunk->switchCapacity;
+        chunk->switchCapacity = GROW_CAPACITY(oldCapacity);
+        chunk->switches = GROW_ARRAY(SwitchTable, chunk->switches,
+            oldCapacity, chunk->switchCapacity);
+    }
+
+    SwitchTable* table = &chunk->switches[chunk->switchCount];
+    table->defaultOffset = -1;
+    table->min = 0;
+    table->offsetCount = 0;
+    table->offsets = NULL;
+    initValueTable(&table->cases);
+    return chunk->switchCount++;
+}
+
+// Records that the code from start up to the end of the chunk is the body
+// of the named function, inlined at a call on line.
+void addInlinedCall(Chunk* chunk, int start, int line, ObjString* name) {
+    if (chunk->count == start) return;
+
+    if (chunk->inlinedCapacity < chunk->inlinedCount + 1) {
+        push(OBJ_VAL(name));
+        int oldCapacity = chunk->inlinedCapacity;
+        chunk->inlinedCapacity = GROW_CAPACITY(oldCapacity);
+        chunk->inlined = GROW_ARRAY(InlinedCall, chunk->inlined,
+            oldCapacity, chunk->inlinedCapacity);
+        pop();
+    }
+
+    InlinedCall* call = &chunk->inlined[chunk->inlinedCount++];
+    call->start = start;
+    call->end = chunk->count;
+    call->line = line;
+    call->name = name;
+}
+
+InlinedCall* findInlinedCall(Chunk* chunk, int instruction) {
+    for (int i = 0; i < chunk->inlinedCount; i++) {
+        InlinedCall* call = &chunk->inlined[i];
+        if (instruction >= call->start && instruction < call->end) {
+            return call;
+        }
+    }
+    return NULL;
+}
+
 int getLine(Chunk* chunk, int instruction) {
     int start = 0;
     int end = chunk->lineCount - 1;
@@ -87,3 +174,15 @@ int getLine(Chunk* chunk, int instruction) {
         }
     }
 }
+
+int addCallCache(Chunk* chunk) {
+    if (chunk->callCapacity < chunk->callCount + 1) {
+        int oldCapacity = chunk->callCapacity;
+        chunk->callCapacity = GROW_CAPACITY(oldCapacity);
+        chunk->calls = GROW_ARRAY(CallCache, chunk->calls,
+            oldCapacity, chunk->callCapacity);
+    }
+
+    chunk->calls[chunk->callCount].callee = NULL;
+    return chunk->callCount++;
+}
@@ -2,31 +2,81 @@
 #define awit_chunk_h
 
 #include "common.h"
+#include "table.h"
 #include "value.h"
 
+// Every instruction that takes a constant, slot or jump operand has a
+// OP_LONG_* twin placed right after it. The short form carries a 1-byte
+// operand (2 bytes for jumps) while the long form carries 3 bytes, so the
+// compiler can emit "op + 1" whenever the operand does not fit.
 typedef enum {
     OP_CONSTANT,
     OP_LONG_CONSTANT,
+    OP_PUSH_SMALL_INT,
     OP_NULL,
     OP_TRUE,
     OP_FALSE,
     OP_POP,
     OP_DUP,
     OP_GET_LOCAL,
+    OP_LONG_GET_LOCAL,
     OP_SET_LOCAL,
+    OP_LONG_SET_LOCAL,
+    OP_INC_LOCAL,
+    OP_LONG_INC_LOCAL,
+    OP_DEC_LOCAL,
+    OP_LONG_DEC_LOCAL,
+    OP_MODIFY_LOCAL,
+    OP_LONG_MODIFY_LOCAL,
     OP_GET_GLOBAL,
+    OP_LONG_GET_GLOBAL,
     OP_DEFINE_GLOBAL,
+    OP_LONG_DEFINE_GLOBAL,
     OP_SET_GLOBAL,
+    OP_LONG_SET_GLOBAL,
+    OP_INC_GLOBAL,
+    OP_LONG_INC_GLOBAL,
+    OP_DEC_GLOBAL,
+    OP_LONG_DEC_GLOBAL,
+    OP_MODIFY_GLOBAL,
+    OP_LONG_MODIFY_GLOBAL,
+    OP_DEFINED,
+    OP_LONG_DEFINED,
     OP_GET_ELEMENT,
+    OP_GET_ELEMENT_UNCHECKED,
+    OP_GET_ELEMENT_2D,
     OP_DEFINE_ARRAY,
+    OP_LONG_DEFINE_ARRAY,
+    OP_DEFINE_MAP,
+    OP_LONG_DEFINE_MAP,
     OP_DECLARE_ARRAY,
     OP_MULTI_ARRAY,
     OP_SET_ELEMENT,
+    OP_SET_ELEMENT_UNCHECKED,
+    OP_SET_ELEMENT_2D,
+    OP_MODIFY_ELEMENT,
+    OP_MODIFY_ELEMENT_2D,
+    OP_CHECK_RANGE,
+    OP_GET_CAPTURED,
+    OP_LONG_GET_CAPTURED,
     OP_GET_UPVALUE,
+    OP_LONG_GET_UPVALUE,
     OP_SET_UPVALUE,
+    OP_LONG_SET_UPVALUE,
+    OP_INC_UPVALUE,
+    OP_LONG_INC_UPVALUE,
+    OP_DEC_UPVALUE,
+    OP_LONG_DEC_UPVALUE,
+    OP_MODIFY_UPVALUE,
+    OP_LONG_MODIFY_UPVALUE,
     OP_GET_PROPERTY,
+    OP_LONG_GET_PROPERTY,
     OP_SET_PROPERTY,
+    OP_LONG_SET_PROPERTY,
+    OP_MODIFY_PROPERTY,
+    OP_LONG_MODIFY_PROPERTY,
     OP_GET_SUPER,
+    OP_LONG_GET_SUPER,
     OP_EQUAL,
     OP_GREATER,
     OP_LESS,
@@ -36,28 +86,90 @@ typedef enum {
     OP_MULTIPLY,
     OP_INT_DIVIDE,
     OP_DIVIDE,
+    OP_GREATER_NUMBER,
+    OP_LESS_NUMBER,
+    OP_ADD_NUMBER,
+    OP_ADD_STRING,
+    OP_SUBTRACT_NUMBER,
+    OP_MULTIPLY_NUMBER,
+    OP_DIVIDE_NUMBER,
+    OP_EQUAL_IMM,
+    OP_GREATER_IMM,
+    OP_LESS_IMM,
+    OP_ADD_IMM,
+    OP_SUBTRACT_IMM,
+    OP_MODULO_IMM,
+    OP_MULTIPLY_IMM,
     OP_NOT,
     OP_NEGATE,
     OP_PRINT,
+    OP_SWITCH,
+    OP_LONG_SWITCH,
     OP_JUMP,
+    OP_LONG_JUMP,
     OP_JUMP_IF_FALSE,
+    OP_LONG_JUMP_IF_FALSE,
     OP_LOOP,
+    OP_LONG_LOOP,
+    OP_ITERATOR,
+    OP_FOR_EACH,
+    OP_LONG_FOR_EACH,
     OP_CALL,
+    OP_LONG_CALL,
     OP_INVOKE,
+    OP_LONG_INVOKE,
     OP_SUPER_INVOKE,
+    OP_LONG_SUPER_INVOKE,
     OP_CLOSURE,
+    OP_LONG_CLOSURE,
     OP_CLOSE_UPVALUE,
     OP_RETURN,
     OP_CLASS,
+    OP_LONG_CLASS,
     OP_INHERIT,
-    OP_METHOD
+    OP_METHOD,
+    OP_LONG_METHOD
 } OpCode;
 
+// Operand flags of OP_CHECK_RANGE.
+#define RANGE_INCLUSIVE 0x1     // The loop runs while 'i <= end'.
+#define RANGE_SUBTRACT  0x2     // The index is 'i - offset'.
+
+// Flags of each upvalue captured by OP_CLOSURE.
+#define UPVALUE_LOCAL   0x1     // A slot of the enclosing function.
+#define UPVALUE_VALUE   0x2     // Copied since it is never reassigned.
+
 typedef struct {
     int offset;
     int line;
 } LineStart;
 
+// Jump targets of a 'suriin' whose 'kapag' labels are all literals.
+// Dense integer labels index offsets directly by (value - min), any
+// other labels are looked up in cases. Offsets are from the chunk start.
+typedef struct {
+    int defaultOffset;
+    double min;
+    int offsetCount;
+    int* offsets;
+    ValueTable cases;
+} SwitchTable;
+
+// Code compiled from the body of an inlined function, so that an error in
+// it still names the function in the trace like a call would.
+typedef struct {
+    int start;
+    int end;
+    int line;               // Of the call.
+    ObjString* name;
+} InlinedCall;
+
+// The callee an OP_CALL site saw last, kept only when it is a closure
+// whose arity matched or a native, so the next call can skip the checks.
+typedef struct {
+    Obj* callee;
+} CallCache;
+
 typedef struct {
     int count;
     int capacity;
@@ -66,13 +178,30 @@ typedef struct {
     int lineCapacity;
     LineStart* lines;
     ValueArray constants;
+    int switchCount;
+    int switchCapacity;
+    SwitchTable* switches;
+    int callCount;
+    int callCapacity;
+    CallCache* calls;
+    int inlinedCount;
+    int inlinedCapacity;
+    InlinedCall* inlined;
+    // How many times the instruction at each offset fell back from its
+    // specialized form. Allocated on the first fall back.
+    uint8_t* fallbacks;
 } Chunk;
 
 void initChunk(Chunk* chunk);
 void freeChunk(Chunk* chunk);
+void shrinkChunk(Chunk* chunk);
 void writeChunk(Chunk* chunk, uint8_t byte, int line);
 void writeConstant(Chunk* chunk, Value value, int line);
 int addConstant(Chunk* chunk, Value value);
+int addSwitchTable(Chunk* chunk);
+int addCallCache(Chunk* chunk);
+void addInlinedCall(Chunk* chunk, int start, int line, ObjString* name);
+InlinedCall* findInlinedCall(Chunk* chunk, int instruction);
 int getLine(Chunk* chunk, int instruction);
 
 #endif
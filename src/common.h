@@ -11,6 +11,29 @@
 // #define DEBUG_STRESS_GC
 // #define DEBUG_LOG_GC
 
+// Largest body, in tokens, of a function that the compiler may copy into
+// its callers. Set to 0 to turn inlining off.
+#define INLINE_MAX_TOKENS 32
+
+// Largest 'kada' or 'habang' loop, in tokens, that the compiler looks
+// through for invariant names and array indexes to check only once.
+// Set to 0 to turn the loop guards off.
+#define LOOP_GUARD_MAX_TOKENS 512
+
+// Times an arithmetic or comparison instruction may fall back from its
+// specialized form before it stays generic. Set to 0 to turn quickening
+// off.
+#define QUICKEN_MAX_FALLBACKS 2
+
+// Runs of at most this many elements are sorted by insertion.
+#define SORT_INSERTION_MAX 16
+
+// Bytes of 'ipakita' output kept before they are written to stdout, until
+// a script changes it with 'itakdaLabas'.
+#define OUTPUT_BUFFER_SIZE 8192
+
 #define UINT8_COUNT (UINT8_MAX + 1)
+#define UINT16_COUNT (UINT16_MAX + 1)
+#define UINT24_MAX 0xffffff
 
 #endif
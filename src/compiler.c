@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,13 +7,16 @@
 #include "compiler.h"
 #include "memory.h"
 #include "scanner.h"
+#include "vm.h"
 
 #ifdef DEBUG_PRINT_CODE
 #include "debug.h"
 #endif
 
-#define MAX_CASES 256
 #define MAX_BREAKS 256
+#define SWITCH_TABLE_MIN_CASES 3
+#define MAX_INLINE_PARAMS 8
+#define MAX_LOOP_NAMES 32
 
 typedef struct {
     Token current;
@@ -48,11 +52,14 @@ typedef struct {
     Token name;
     int depth;
     bool isCaptured;
+    Scanner scope;      // Positioned right after the declaration.
+    int isFinal;        // Never reassigned; -1 until scope is scanned.
 } Local;
 
 typedef struct {
-    uint8_t index;
+    int index;
     bool isLocal;
+    bool isValue;       // Holds a copy of a variable that never changes.
 } Upvalue;
 
 typedef enum {
@@ -67,12 +74,99 @@ typedef struct Compiler {
     ObjFunction* function;
     FunctionType type;
     
-    Local locals[UINT8_COUNT];
+    Local* locals;
     int localCount;
-    Upvalue upvalues[UINT8_COUNT];
+    int localCapacity;
+    Upvalue* upvalues;
+    int upvalueCapacity;
     int scopeDepth;
+
+    // Maps each constant already in the chunk to its index so repeated
+    // names and literals share a single slot.
+    ValueTable constants;
+
+    // Forward jumps are emitted with a 2-byte offset unless longJumps is
+    // set. If one of them does not fit, jumpOverflow is raised and the
+    // whole function body is compiled again with 3-byte offsets.
+    bool longJumps;
+    bool jumpOverflow;
+
+    int inlinedCalls;
+
+    // Stands in while a function is scanned in lazy mode. The body
+    // may still be shadowing the names it captures, so they are shared.
+    bool isLazy;
+
+    // The constant pushed by the instruction from constantStart up to
+    // constantEnd, so an operator applied to it can be folded while it is
+    // still the last one. Code that a jump lands in is never folded.
+    int constantStart;
+    int constantEnd;
+    Value constantValue;
+    int jumpTarget;
 } Compiler;
 
+// A top-level 'gawain' small enough to have its body compiled again in
+// place of a call. Only functions that are never reassigned, do not refer
+// to themselves and declare no functions or classes qualify.
+typedef struct {
+    Token name;
+    Token params[MAX_INLINE_PARAMS];
+    int arity;
+    Scanner body;           // Positioned right after the opening '{'.
+    bool isExpression;      // The body is a lone 'ibalik <ekspresyon>;'.
+    bool hasCall;
+    bool hasAssignment;
+    bool isDeclared;        // Calls compiled after this may be inlined.
+    bool isReassigned;
+} InlineFunction;
+
+typedef struct {
+    int slot;               // Local of the caller, or -1 for a literal.
+    Token literal;
+    bool isNegative;
+} InlineArgument;
+
+// While a body is being inlined the caller's variables are hidden from it:
+// only locals from localBase up are visible and every other name is a
+// global. Parameters either live in those locals or, if arguments is set,
+// are replaced by the caller's arguments directly.
+typedef struct {
+    InlineFunction* callee;
+    int localBase;
+    InlineArgument* arguments;
+} InlineSite;
+
+// A top-level 'konst'. Its value is compiled in place of its name, so it
+// has no storage at runtime.
+typedef struct {
+    Token name;
+    Value value;
+} Konstant;
+
+// An element access 'a[i]', 'a[i + k]', 'a[k + i]' or 'a[i - k]' on the
+// variable of a 'kada' loop, where k is a name or a number.
+typedef struct {
+    Token array;
+    Token offset;
+    bool hasOffset;
+    bool isSubtract;
+} GuardedIndex;
+
+// What the compiler found out about a loop by looking through it first.
+// The hoisted names are read once into locals in front of the loop, and
+// the indexes are checked once against the loop bounds so they can use
+// the unchecked element instructions.
+typedef struct {
+    Token hoisted[MAX_LOOP_NAMES];
+    int hoistedCount;
+    int loopVariable;       // -1 when the loop has no usable bounds.
+    Token bound;
+    bool isInclusive;
+    GuardedIndex indexes[MAX_LOOP_NAMES];
+    int indexCount;
+} LoopGuard;
+
 typedef struct ClassCompiler {
     struct ClassCompiler* enclosing;
     bool hasSuperclass;
@@ -84,8 +178,40 @@ ClassCompiler* currentClass = NULL;
 
 int innermostLoopStart = -1;
 int innermostLoopExits[MAX_BREAKS]; // Can also be used on Switch.
-int innermostLoopExitCount = -1;
-int innermostLoopDepth = 0;         // Can also be used on Switch.
+int innermostLoopExitCount = 0;     // Pending exits of all enclosing loops.
+int innermostLoopDepth = 0;
+int innermostExitDepth = -1;        // Can also be used on Switch.
+
+InlineFunction* inlineFunctions = NULL;
+int inlineFunctionCount = 0;
+int inlineFunctionCapacity = 0;
+InlineSite* inlineSite = NULL;
+
+// The whole script while it is compiled, NULL while a lazily compiled
+// function is.
+static const char* scriptSource = NULL;
+
+// Whether function bodies are only compiled when they are first called.
+static bool lazyBodies = false;
+
+// The names declared or assigned in the script, only found once a call to
+// a native could be folded.
+Table writtenNames;
+bool hasWrittenNames = false;
+
+Konstant* konstants = NULL;
+int konstantCount = 0;
+int konstantCapacity = 0;
+
+// The globals declared so far in the script, which a 'konst' can't reuse.
+Token* globalNames = NULL;
+int globalNameCount = 0;
+int globalNameCapacity = 0;
+
+LoopGuard* loopGuard = NULL;
+bool isGuardedElement = false;     // The next '[]' was checked by loopGuard.
+
+ObjFunction* lazyCompiled = NULL;
 
 static Chunk* currentChunk() {
     return &current->function->chunk;
@@ -94,6 +220,8 @@ static Chunk* currentChunk() {
 static void errorAt(Token* token, const char* message) {
     if (parser.panicMode) return;
     parser.panicMode = true;
+    // Functions may be compiled while the script is already printing.
+    flushOutput();
     fprintf(stderr, "[linya %d] Mali", token->line);
 
     if (token->type == TOKEN_DULO) {
@@ -150,28 +278,83 @@ static bool match(TokenType type) {
     return true;        
 }
 
-static void emitConstant(Value value) {
-    writeConstant(currentChunk(), value, parser.previous.line);
+// Matches '+=', '-=', '*=' or '/=' and gives the arithmetic instruction
+// each of them applies.
+static bool matchCompound(uint8_t* operation) {
+    if (match(TOKEN_DAGDAG_KATUMBAS)) {
+        *operation = OP_ADD;
+    } else if (match(TOKEN_BAWAS_KATUMBAS)) {
+        *operation = OP_SUBTRACT;
+    } else if (match(TOKEN_BITUIN_KATUMBAS)) {
+        *operation = OP_MULTIPLY;
+    } else if (match(TOKEN_SULONG_PAHILIS_KATUMBAS)) {
+        *operation = OP_DIVIDE;
+    } else {
+        return false;
+    }
+
+    return true;
 }
 
 static void patchJump(int offset) {
+    current->jumpTarget = currentChunk()->count;
+
+    if (current->longJumps) {
+        // -3 to adjust for the bytecode for the jump offset itself.
+        int jump = currentChunk()->count - offset - 3;
+
+        if (jump > UINT24_MAX) {
+            error("Masyadong maraming nilalaman upang puntahan.");
+        }
+
+        currentChunk()->code[offset] = (jump >> 16) & 0xff;
+        currentChunk()->code[offset + 1] = (jump >> 8) & 0xff;
+        currentChunk()->code[offset + 2] = jump & 0xff;
+        return;
+    }
+
     // -2 to adjust for the bytecode for the jump offset itself.
     int jump = currentChunk()->count - offset - 2;
 
     if (jump > UINT16_MAX) {
-        error("Masyadong maraming nilalaman upang puntahan.");
+        // Not an error, the caller recompiles with long jumps.
+        current->jumpOverflow = true;
+        return;
     }
 
     currentChunk()->code[offset] = (jump >> 8) & 0xff;
     currentChunk()->code[offset + 1] = jump & 0xff;
 }
 
-static void initCompiler(Compiler* compiler, FunctionType type) {
+// Patches the 'itigil' jumps added since the loop or switch began.
+static void patchExits(int surroundingExitCount) {
+    for (int i = surroundingExitCount; i < innermostLoopExitCount; i++) {
+        patchJump(innermostLoopExits[i]);
+    }
+
+    innermostLoopExitCount = surroundingExitCount;
+}
+
+static void initCompiler(Compiler* compiler, FunctionType type,
+                         bool longJumps) {
     compiler->enclosing = current;
     compiler->function = NULL;
     compiler->type = type;
+    compiler->locals = NULL;
     compiler->localCount = 0;
+    compiler->localCapacity = 0;
+    compiler->upvalues = NULL;
+    compiler->upvalueCapacity = 0;
     compiler->scopeDepth = 0;
+    initValueTable(&compiler->constants);
+    compiler->longJumps = longJumps;
+    compiler->jumpOverflow = false;
+    compiler->inlinedCalls = 0;
+    compiler->isLazy = false;
+    compiler->constantStart = -1;
+    compiler->constantEnd = -1;
+    compiler->constantValue = NULL_VAL;
+    compiler->jumpTarget = 0;
     compiler->function = newFunction();
     current = compiler;
     if (type != TYPE_SCRIPT) {
@@ -179,9 +362,13 @@ static void initCompiler(Compiler* compiler, FunctionType type) {
                                              parser.previous.length);
     }
 
+    current->localCapacity = GROW_CAPACITY(0);
+    current->locals = GROW_ARRAY(Local, NULL, 0, current->localCapacity);
+
     Local* local = &current->locals[current->localCount++];
     local->depth = 0;
     local->isCaptured = false;
+    local->isFinal = 1;
     if (type != TYPE_FUNCTION) {
         local->name.start = "ito";
         local->name.length = 3;
@@ -200,29 +387,47 @@ static void emitBytes(uint8_t byte1, uint8_t byte2) {
     emitByte(byte2);
 }
 
-static void emitVariable(uint8_t setGetOp, int index) {
-    emitByte(setGetOp);
+static void emitLong(int operand) {
+    emitByte((uint8_t)((operand >> 16) & 0xff));
+    emitBytes((uint8_t)((operand >> 8) & 0xff),
+              (uint8_t)(operand & 0xff));
+}
 
-    if (index < UINT8_MAX) {
-        emitByte((uint8_t)index);
+// Emits the compact 1-byte form of the instruction when the operand fits,
+// otherwise its OP_LONG_* twin (always the next opcode) with 3 bytes.
+static void emitOperand(uint8_t instruction, int operand) {
+    if (operand <= UINT8_MAX) {
+        emitBytes(instruction, (uint8_t)operand);
     } else {
-        emitByte((uint8_t)((index >> 16) & 0xFF));
-        emitBytes((uint8_t)((index >> 8) & 0xFF),
-                  (uint8_t)(index & 0xFF));
+        emitByte(instruction + 1);
+        emitLong(operand);
     }
 }
 
 static void emitLoop(int loopStart) {
-    emitByte(OP_LOOP);
+    // +3 for the OP_LOOP and its 2-byte offset.
+    int offset = currentChunk()->count - loopStart + 3;
+    if (offset <= UINT16_MAX) {
+        emitByte(OP_LOOP);
+        emitByte((offset >> 8) & 0xff);
+        emitByte(offset & 0xff);
+        return;
+    }
 
-    int offset = currentChunk()->count - loopStart + 2;
-    if (offset > UINT16_MAX) error("Masyadong marami ang nilalaman ng pahayag.");
+    offset++; // The long offset takes one more byte.
+    if (offset > UINT24_MAX) error("Masyadong marami ang nilalaman ng pahayag.");
 
-    emitByte((offset >> 8) & 0xff);
-    emitByte(offset & 0xff);
+    emitByte(OP_LONG_LOOP);
+    emitLong(offset);
 }
 
 static int emitJump(uint8_t instruction) {
+    if (current->longJumps) {
+        emitByte(instruction + 1);
+        emitLong(UINT24_MAX);
+        return currentChunk()->count - 3;
+    }
+
     emitByte(instruction);
     emitByte(0xff);
     emitByte(0xff);
@@ -240,18 +445,120 @@ static void emitReturn() {
 }
 
 static int makeConstant(Value value) {
+    // Negative zero equals zero but prints differently, keep it apart.
+    bool isNegativeZero = IS_NUMBER(value) && AS_NUMBER(value) == 0 &&
+                          signbit(AS_NUMBER(value));
+
+    Value index;
+    if (!isNegativeZero &&
+        valueTableGet(&current->constants, value, &index)) {
+        return (int)AS_NUMBER(index);
+    }
+
     int constant = addConstant(currentChunk(), value);
+    if (constant > UINT24_MAX) {
+        error("Masyadong maraming halaga sa isang gawain.");
+        return 0;
+    }
+
+    if (!isNegativeZero) {
+        valueTableSet(&current->constants, value, NUMBER_VAL(constant));
+    }
+
     return constant;
 }
 
+static void emitConstant(Value value) {
+    emitOperand(OP_CONSTANT, makeConstant(value));
+}
+
+// Small integral literals are embedded in the instruction as a signed
+// 16-bit operand instead of being loaded from the constant table. A
+// negative zero has to keep its sign, so it stays a constant.
+static bool isSmallInteger(double value) {
+    return value >= INT16_MIN && value <= INT16_MAX &&
+        value == (int)value && (value != 0 || !signbit(value));
+}
+
+static void emitImmediate(uint8_t instruction, int value) {
+    emitByte(instruction);
+    emitBytes((uint8_t)((value >> 8) & 0xff), (uint8_t)(value & 0xff));
+}
+
+static void emitNumber(double value) {
+    if (isSmallInteger(value)) {
+        emitImmediate(OP_PUSH_SMALL_INT, (int)value);
+    } else {
+        emitConstant(NUMBER_VAL(value));
+    }
+}
+
+// Pushes a value known while compiling and remembers it for folding.
+static void emitValue(Value value) {
+    int start = currentChunk()->count;
+    if (IS_NUMBER(value)) {
+        emitNumber(AS_NUMBER(value));
+    } else if (IS_BOOL(value)) {
+        emitByte(AS_BOOL(value) ? OP_TRUE : OP_FALSE);
+    } else if (IS_NULL(value)) {
+        emitByte(OP_NULL);
+    } else {
+        emitConstant(value);
+    }
+
+    current->constantStart = start;
+    current->constantEnd = currentChunk()->count;
+    current->constantValue = value;
+}
+
+// Whether the code compiled last is only the push of a constant, which
+// then starts at start.
+static bool lastConstant(Value* value, int* start) {
+    if (current->constantEnd != currentChunk()->count ||
+        current->jumpTarget > current->constantStart) {
+        return false;
+    }
+
+    *value = current->constantValue;
+    *start = current->constantStart;
+    return true;
+}
+
+// Drops the code from offset on so something else can be compiled there.
+static void rewindChunk(int offset) {
+    Chunk* chunk = currentChunk();
+    chunk->count = offset;
+
+    // So does the line of code that starts past the end.
+    while (chunk->lineCount > 0 &&
+           chunk->lines[chunk->lineCount - 1].offset >= offset) {
+        chunk->lineCount--;
+    }
+
+    // Inlined bodies that were compiled into the dropped code go too.
+    while (chunk->inlinedCount > 0 &&
+           chunk->inlined[chunk->inlinedCount - 1].start >= offset) {
+        chunk->inlinedCount--;
+    }
+    if (chunk->inlinedCount > 0 &&
+        chunk->inlined[chunk->inlinedCount - 1].end > offset) {
+        chunk->inlined[chunk->inlinedCount - 1].end = offset;
+    }
+    current->constantEnd = -1;
+}
+
 static ObjFunction* endCompiler() {
     emitReturn();
     ObjFunction* function = current->function;
+    shrinkChunk(&function->chunk);
 
 #ifdef DEBUG_PRINT_CODE
-    if (!parser.hadError) {
+    if (!parser.hadError && !current->jumpOverflow) {
         disassembleChunk(currentChunk(), function->name != NULL
             ? function->name->chars : "<skrip>");
+        if (current->inlinedCalls > 0) {
+            printf("-- %d inlined call(s)\n", current->inlinedCalls);
+        }
     }
 #endif
 
@@ -259,6 +566,12 @@ static ObjFunction* endCompiler() {
     return function;
 }
 
+static void freeCompiler(Compiler* compiler) {
+    FREE_ARRAY(Local, compiler->locals, compiler->localCapacity);
+    FREE_ARRAY(Upvalue, compiler->upvalues, compiler->upvalueCapacity);
+    freeValueTable(&compiler->constants);
+}
+
 static void beginScope() {
     current->scopeDepth++;
 }
@@ -294,7 +607,10 @@ static bool identifiersEqual(Token* a, Token* b) {
 }
 
 static int resolveLocal(Compiler* compiler, Token* name) {
-    for (int i = compiler->localCount - 1; i >= 0; i--) {
+    int base = inlineSite != NULL && compiler == current ?
+        inlineSite->localBase : 0;
+
+    for (int i = compiler->localCount - 1; i >= base; i--) {
         Local* local = &compiler->locals[i];
         if (identifiersEqual(name, &local->name)) {
             if (local->depth == -1) {
@@ -307,8 +623,8 @@ static int resolveLocal(Compiler* compiler, Token* name) {
     return -1;
 }
 
-static int addUpvalue(Compiler* compiler, uint8_t index,
-                      bool isLocal) {
+static int addUpvalue(Compiler* compiler, int index,
+                      bool isLocal, bool isValue) {
     int upvalueCount = compiler->function->upvalueCount;
 
     for (int i = 0; i < upvalueCount; i++) {
@@ -318,51 +634,150 @@ static int addUpvalue(Compiler* compiler, uint8_t index,
         }
     }
 
-    if (upvalueCount == UINT8_COUNT) {
+    if (upvalueCount == UINT16_COUNT) {
         error("Masyadong maraming 'closure' na pagkakakilanlan sa gawain.");
         return 0;
     }
 
+    if (compiler->upvalueCapacity < upvalueCount + 1) {
+        int oldCapacity = compiler->upvalueCapacity;
+        compiler->upvalueCapacity = GROW_CAPACITY(oldCapacity);
+        compiler->upvalues = GROW_ARRAY(Upvalue, compiler->upvalues,
+            oldCapacity, compiler->upvalueCapacity);
+    }
+
     compiler->upvalues[upvalueCount].isLocal = isLocal;
+    compiler->upvalues[upvalueCount].isValue = isValue;
     compiler->upvalues[upvalueCount].index = index;
     return compiler->function->upvalueCount++;
 }
 
+// The outermost compiler of a function compiled on its first call has no
+// enclosing compiler; its upvalues were captured under these names.
+static int lazyUpvalue(Token* name) {
+    if (lazyCompiled == NULL) return -1;
+
+    ValueArray* names = &lazyCompiled->upvalueNames;
+    for (int i = 0; i < names->count; i++) {
+        ObjString* upvalueName = AS_STRING(names->values[i]);
+        if (upvalueName->length == name->length &&
+            memcmp(upvalueName->chars, name->start, name->length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static bool isAssignmentToken(TokenType type);
+
+// Scans from the declaration of the local to the end of its scope for a
+// write to its name. Writes to other variables of the same name count too.
+static bool isFinal(Local* local) {
+    if (local->isFinal != -1) return local->isFinal;
+
+    Scanner scannerState = saveScanner();
+    restoreScanner(local->scope);
+
+    bool isReassigned = false;
+    int depth = 0;
+    TokenType previous = TOKEN_PROBLEMA;
+    Token token = scanToken();
+    while (!isReassigned && token.type != TOKEN_DULO) {
+        Token next = scanToken();
+        if (token.type == TOKEN_KALIWANG_BRACE) {
+            depth++;
+        } else if (token.type == TOKEN_KANANG_BRACE) {
+            if (depth-- == 0) break;
+        } else if (token.type == TOKEN_PAGKAKAKILANLAN &&
+                   previous != TOKEN_TULDOK &&
+                   identifiersEqual(&token, &local->name)) {
+            isReassigned = isAssignmentToken(next.type) ||
+                previous == TOKEN_DAGDAG_ISA || previous == TOKEN_BAWAS_ISA;
+        }
+        previous = token.type;
+        token = next;
+    }
+
+    restoreScanner(scannerState);
+    local->isFinal = !isReassigned;
+    return local->isFinal;
+}
+
+// A local that is never reassigned is copied into the closure, so it is
+// read without going through an ObjUpvalue and never has to be closed.
 static int resolveUpvalue(Compiler* compiler, Token* name) {
-    if (compiler->enclosing == NULL) return -1;
+    if (compiler->enclosing == NULL) {
+        return compiler->type == TYPE_SCRIPT ? -1 : lazyUpvalue(name);
+    }
 
-    // This assumes that the local is NOT a LONG_CONSTANT.
-    // Else the compiler will break. But it was not implemented
-    // since it is a rare case and adding more complexity in the 
-    // later stage of the interpreter is not worth it.
     int local = resolveLocal(compiler->enclosing, name);
     if (local != -1) {
-        compiler->enclosing->locals[local].isCaptured = true;
-        return addUpvalue(compiler, (uint8_t)local, true);
+        Local* captured = &compiler->enclosing->locals[local];
+        bool isValue = !compiler->isLazy && isFinal(captured);
+        if (!isValue) captured->isCaptured = true;
+        return addUpvalue(compiler, local, true, isValue);
     }
 
     int upvalue = resolveUpvalue(compiler->enclosing, name);
     if (upvalue != -1) {
-        return addUpvalue(compiler, (uint8_t)upvalue, false);
+        // Upvalues of a function compiled on its first call are shared.
+        bool isValue = compiler->enclosing->enclosing != NULL &&
+            compiler->enclosing->upvalues[upvalue].isValue;
+        return addUpvalue(compiler, upvalue, false, isValue);
     }
 
     return -1;
 }
 
+// A scanner state that reads parser.current again.
+static Scanner currentPosition() {
+    Scanner position = {parser.current.start, parser.current.start,
+                        parser.current.line};
+    return position;
+}
+
 static void addLocal(Token name) {
-    if (current->localCount == UINT8_COUNT) {
+    if (current->localCount == UINT16_COUNT) {
         error("Masyadong maraming lalagyan ng halaga sa kasalukuyang gawain.");
         return;
     }
 
+    if (current->localCapacity < current->localCount + 1) {
+        int oldCapacity = current->localCapacity;
+        current->localCapacity = GROW_CAPACITY(oldCapacity);
+        current->locals = GROW_ARRAY(Local, current->locals,
+            oldCapacity, current->localCapacity);
+    }
+
     Local* local = &current->locals[current->localCount++];
     local->name = name;
     local->depth = -1;
     local->isCaptured = false;
+    local->scope = currentPosition();
+    local->isFinal = -1;
+
+    if (current->localCount > current->function->slotCount) {
+        current->function->slotCount = current->localCount;
+    }
+}
+
+static void addGlobalName(Token name) {
+    if (globalNameCapacity < globalNameCount + 1) {
+        int oldCapacity = globalNameCapacity;
+        globalNameCapacity = GROW_CAPACITY(oldCapacity);
+        globalNames = GROW_ARRAY(Token, globalNames, oldCapacity,
+                                 globalNameCapacity);
+    }
+
+    globalNames[globalNameCount++] = name;
 }
 
 static void declareVariable() {
-    if (current->scopeDepth == 0) return;
+    if (current->scopeDepth == 0) {
+        if (current->type == TYPE_SCRIPT) addGlobalName(parser.previous);
+        return;
+    }
 
     Token* name = &parser.previous;
     for (int i = current->localCount - 1; i >= 0; i--) {
@@ -379,8 +794,14 @@ static void declareVariable() {
     addLocal(*name);
 }
 
+static Konstant* findKonstant(Token* name);
+
 static int parseVariable(const char* errorMessage) {
     consume(TOKEN_PAGKAKAKILANLAN, errorMessage);
+    if (current->type == TYPE_SCRIPT && current->scopeDepth == 0 &&
+        findKonstant(&parser.previous) != NULL) {
+        error("Mayroon ng konst na may ganitong pangalan.");
+    }
 
     declareVariable();
     if (current->scopeDepth > 0) return 0;
@@ -400,16 +821,16 @@ static void defineVariable(int global) {
         return;
     }
 
-    emitBytes(OP_DEFINE_GLOBAL, global);
+    emitOperand(OP_DEFINE_GLOBAL, global);
 }
 
-static uint8_t elementList() {
-    uint8_t argCount = 0;
+static int elementList() {
+    int argCount = 0;
     if (!check(TOKEN_KANANG_BRACKET)) {
         do {
             expression();
-            if (argCount == 255) {
-                error("Hindi maaaring magkaroon ng higit sa 255 na mga halaga");
+            if (argCount == UINT16_MAX) {
+                error("Hindi maaaring magkaroon ng higit sa 65535 na mga halaga");
             }
             argCount++;
         } while (match(TOKEN_KUWIT));
@@ -435,11 +856,109 @@ static uint8_t argumentList() {
     return argCount;
 }
 
+// Compiles 'a <operator> b' into a single instruction when b is just a
+// small integer, like the 'n - 1' and 'n < 2' in recursive functions. The
+// push of b, from start on, is replaced.
+static bool immediateBinary(TokenType operatorType, Value operand,
+                            int start) {
+    if (!IS_NUMBER(operand) || !isSmallInteger(AS_NUMBER(operand))) {
+        return false;
+    }
+
+    double value = AS_NUMBER(operand);
+
+    uint8_t instruction;
+    bool negate = false;
+    switch (operatorType) {
+        case TOKEN_HINDI_PAREHO:    negate = true; // Fallthrough.
+        case TOKEN_PAREHO:          instruction = OP_EQUAL_IMM; break;
+        case TOKEN_HIGIT:           instruction = OP_GREATER_IMM; break;
+        case TOKEN_HIGIT_PAREHO:    negate = true; // Fallthrough.
+        case TOKEN_BABA:            instruction = OP_LESS_IMM; break;
+        case TOKEN_BABA_PAREHO:     negate = true;
+                                    instruction = OP_GREATER_IMM; break;
+        case TOKEN_DAGDAG:          instruction = OP_ADD_IMM; break;
+        case TOKEN_BAWAS:           instruction = OP_SUBTRACT_IMM; break;
+        case TOKEN_BITUIN:          instruction = OP_MULTIPLY_IMM; break;
+        case TOKEN_MODULO:
+            if (value == 0) return false;
+            instruction = OP_MODULO_IMM;
+            break;
+        default: return false;
+    }
+
+    rewindChunk(start);
+    emitImmediate(instruction, (int)value);
+    if (negate) emitByte(OP_NOT);
+    return true;
+}
+
+// Computes an operator on two constants while compiling, the same way its
+// instruction would. Whatever could fail or differ at runtime is left to
+// the instruction.
+static bool foldBinary(TokenType operatorType, Value a, Value b,
+                       Value* result) {
+    if (operatorType == TOKEN_PAREHO || operatorType == TOKEN_HINDI_PAREHO) {
+        bool isEqual = valuesEqual(a, b);
+        *result = BOOL_VAL(operatorType == TOKEN_PAREHO ? isEqual : !isEqual);
+        return true;
+    }
+
+    if (!IS_NUMBER(a) || !IS_NUMBER(b)) return false;
+
+    double x = AS_NUMBER(a);
+    double y = AS_NUMBER(b);
+    switch (operatorType) {
+        case TOKEN_HIGIT:          *result = BOOL_VAL(x > y); break;
+        case TOKEN_HIGIT_PAREHO:   *result = BOOL_VAL(!(x < y)); break;
+        case TOKEN_BABA:           *result = BOOL_VAL(x < y); break;
+        case TOKEN_BABA_PAREHO:    *result = BOOL_VAL(!(x > y)); break;
+        case TOKEN_DAGDAG:         *result = NUMBER_VAL(x + y); break;
+        case TOKEN_BAWAS:          *result = NUMBER_VAL(x - y); break;
+        case TOKEN_BITUIN:         *result = NUMBER_VAL(x * y); break;
+        case TOKEN_SULONG_PAHILIS: *result = NUMBER_VAL(x / y); break;
+        case TOKEN_MODULO:
+            if (!(fabs(x) < INT32_MAX && fabs(y) < INT32_MAX) ||
+                (int)y == 0) {
+                return false;
+            }
+            *result = NUMBER_VAL((int)x % (int)y);
+            break;
+        case TOKEN_ATRAS_PAHILIS:
+            if (!(fabs(x / y) < INT32_MAX)) return false;
+            *result = NUMBER_VAL((int)(x / y));
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
 static void binary(bool canAssign) {
     TokenType operatorType = parser.previous.type;
     ParseRule* rule = getRule(operatorType);
+
+    Value left;
+    int leftStart;
+    bool isLeftConstant = lastConstant(&left, &leftStart);
+    int rightStart = currentChunk()->count;
+
     parsePrecedence((Precedence)rule->precedence + 1);
 
+    Value right;
+    int start;
+    if (lastConstant(&right, &start) && start == rightStart) {
+        Value result;
+        if (isLeftConstant && foldBinary(operatorType, left, right, &result)) {
+            rewindChunk(leftStart);
+            emitValue(result);
+            return;
+        }
+
+        if (immediateBinary(operatorType, right, start)) return;
+    }
+
     switch (operatorType) {
         case TOKEN_HINDI_PAREHO:    emitBytes(OP_EQUAL, OP_NOT); break;
         case TOKEN_PAREHO:          emitByte(OP_EQUAL); break;
@@ -457,57 +976,108 @@ static void binary(bool canAssign) {
     }
 }
 
+static void emitCall(uint8_t argCount) {
+    // Every call site gets its own cache for the callee it sees.
+    int cache = addCallCache(currentChunk());
+    if (cache <= UINT8_MAX) {
+        emitBytes(OP_CALL, argCount);
+        emitByte((uint8_t)cache);
+    } else {
+        emitBytes(OP_LONG_CALL, argCount);
+        emitLong(cache);
+    }
+}
+
 static void call(bool canAssign) {
-    uint8_t argCount = argumentList();
-    emitBytes(OP_CALL, argCount);
+    emitCall(argumentList());
 }
 
 static void element(bool canAssign) {
     // We can't read parser.previous for the variable name
     // since there will be cases like name[indexOne][indexTwo]
     // so we leave everything on the stack.
+    bool isGuarded = isGuardedElement;
+    isGuardedElement = false;
+
     expression();
     consume(TOKEN_KANANG_BRACKET, "Inaasahan na makakita ng ']' matapos ang ekspresyon.");
+
+    // name[i][j] reaches the inner element with a single instruction.
+    bool isNested = !isGuarded && match(TOKEN_KALIWANG_BRACKET);
+    if (isNested) {
+        expression();
+        consume(TOKEN_KANANG_BRACKET, "Inaasahan na makakita ng ']' matapos ang ekspresyon.");
+    }
     
-    if (canAssign) {
-        if (match(TOKEN_KATUMBAS)) {
-            expression();
-            emitByte(OP_SET_ELEMENT);
-        } else {
-            emitByte(OP_GET_ELEMENT);
-        }
+    uint8_t operation;
+    if (canAssign && match(TOKEN_KATUMBAS)) {
+        expression();
+        emitByte(isNested ? OP_SET_ELEMENT_2D :
+                 isGuarded ? OP_SET_ELEMENT_UNCHECKED : OP_SET_ELEMENT);
+    } else if (canAssign && matchCompound(&operation)) {
+        // The array and index stay on the stack, so they are evaluated once.
+        expression();
+        emitBytes(isNested ? OP_MODIFY_ELEMENT_2D : OP_MODIFY_ELEMENT,
+                  operation);
     } else {
-        emitByte(OP_GET_ELEMENT);
+        emitByte(isNested ? OP_GET_ELEMENT_2D :
+                 isGuarded ? OP_GET_ELEMENT_UNCHECKED : OP_GET_ELEMENT);
     }
 }
 
 static void array(bool canAssign) {
-    uint8_t elementCount = elementList();
-    emitBytes(OP_DEFINE_ARRAY, elementCount);
+    int elementCount = elementList();
+    emitOperand(OP_DEFINE_ARRAY, elementCount);
+}
+
+// '{' only starts a diksyunaryo where an expression is expected, at the
+// start of a statement it is still a block.
+static void map(bool canAssign) {
+    int pairCount = 0;
+    if (!check(TOKEN_KANANG_BRACE)) {
+        do {
+            expression();
+            consume(TOKEN_TUTULDOK,
+                "Inaasahan na makakita ng ':' matapos ang susi.");
+            expression();
+            if (pairCount == UINT16_MAX) {
+                error("Hindi maaaring magkaroon ng higit sa 65535 na mga susi");
+            }
+            pairCount++;
+        } while (match(TOKEN_KUWIT));
+    }
+    consume(TOKEN_KANANG_BRACE,
+        "Inaasahan na makakita ng '}' matapos ang mga halaga.");
+    emitOperand(OP_DEFINE_MAP, pairCount);
 }
 
 static void dot(bool canAssign) {
     consume(TOKEN_PAGKAKAKILANLAN, 
             "Inaasahan ang pangalan ng katangian matapos ang '.'.");
-    uint8_t name = identifierConstant(&parser.previous);
+    int name = identifierConstant(&parser.previous);
 
+    uint8_t operation;
     if (canAssign && match(TOKEN_KATUMBAS)) {
         expression();
-        emitBytes(OP_SET_PROPERTY, name);
+        emitOperand(OP_SET_PROPERTY, name);
+    } else if (canAssign && matchCompound(&operation)) {
+        expression();
+        emitOperand(OP_MODIFY_PROPERTY, name);
+        emitByte(operation);
     } else if (match(TOKEN_KALIWANG_PAREN)) {
         uint8_t argCount = argumentList();
-        emitBytes(OP_INVOKE, name);
+        emitOperand(OP_INVOKE, name);
         emitByte(argCount);
     } else {
-        emitBytes(OP_GET_PROPERTY, name);
+        emitOperand(OP_GET_PROPERTY, name);
     }
 }
 
 static void literal(bool canAssign) {
     switch (parser.previous.type) {
-        case TOKEN_MALI: emitByte(OP_FALSE); break;
-        case TOKEN_NULL: emitByte(OP_NULL); break;
-        case TOKEN_TAMA: emitByte(OP_TRUE); break;
+        case TOKEN_MALI: emitValue(BOOL_VAL(false)); break;
+        case TOKEN_NULL: emitValue(NULL_VAL); break;
+        case TOKEN_TAMA: emitValue(BOOL_VAL(true)); break;
         default: return; // Unreachable.
     }
 }
@@ -520,7 +1090,7 @@ static void grouping(bool canAssign) {
 
 static void number(bool canAssign) {
     double value = strtod(parser.previous.start, NULL);
-    emitConstant(NUMBER_VAL(value));
+    emitValue(NUMBER_VAL(value));
 }
 
 static void and_(bool canAssign) {
@@ -543,22 +1113,22 @@ static void or_(bool canAssign) {
     patchJump(endJump);
 }
 
-static void string(bool canAssign) {
+static ObjString* parseString(Token* token) {
     // Escape sequences squashes two characters into one.
-    int newLen = parser.previous.length - 2; // - 2 to remove " at beginning and end.
+    int newLen = token->length - 2; // - 2 to remove " at beginning and end.
     char newString[newLen];
 
     for (int oldStringIndex = 1, newStringIndex = 0; 
-         oldStringIndex <= parser.previous.length - 2; 
+         oldStringIndex <= token->length - 2; 
          oldStringIndex++, newStringIndex++) {
         // Continue the iteration if current character is not '\'.
-        if (parser.previous.start[oldStringIndex] != '\\') {
-            newString[newStringIndex] = parser.previous.start[oldStringIndex];
+        if (token->start[oldStringIndex] != '\\') {
+            newString[newStringIndex] = token->start[oldStringIndex];
             continue;
         }
 
         oldStringIndex++; // Consume the '\'.
-        switch (parser.previous.start[oldStringIndex]) {
+        switch (token->start[oldStringIndex]) {
             case 'a':  newString[newStringIndex] = '\a'; break;
             case 'b':  newString[newStringIndex] = '\b'; break;
             case 'f':  newString[newStringIndex] = '\f'; break;
@@ -574,14 +1144,18 @@ static void string(bool canAssign) {
                 // Treat both characters as individual characters and skip the
                 // squashing.
                 newString[newStringIndex] = '\\';
-                newString[++newStringIndex] = parser.previous.start[oldStringIndex];
+                newString[++newStringIndex] = token->start[oldStringIndex];
                 continue;
             }
         }
         newLen--; // Squash the two characters.
     }
 
-    emitConstant(OBJ_VAL(copyString(newString, newLen)));
+    return copyString(newString, newLen);
+}
+
+static void string(bool canAssign) {
+    emitValue(OBJ_VAL(parseString(&parser.previous)));
 }
 
 static void decrement(bool canAssign) {
@@ -592,6 +1166,88 @@ static void increment(bool canAssign) {
     emitByte(OP_ADD);
 }
 
+// The instructions that work on one kind of variable. Each of them has an
+// OP_LONG_* twin.
+typedef struct {
+    uint8_t get;
+    uint8_t set;
+    uint8_t increment;
+    uint8_t decrement;
+    uint8_t modify;
+} VariableOps;
+
+static const VariableOps localOps = {
+    OP_GET_LOCAL, OP_SET_LOCAL, OP_INC_LOCAL, OP_DEC_LOCAL, OP_MODIFY_LOCAL
+};
+static const VariableOps upvalueOps = {
+    OP_GET_UPVALUE, OP_SET_UPVALUE, OP_INC_UPVALUE, OP_DEC_UPVALUE,
+    OP_MODIFY_UPVALUE
+};
+// Copied upvalues are never written to.
+static const VariableOps capturedOps = {
+    OP_GET_CAPTURED, OP_SET_UPVALUE, OP_INC_UPVALUE, OP_DEC_UPVALUE,
+    OP_MODIFY_UPVALUE
+};
+static const VariableOps globalOps = {
+    OP_GET_GLOBAL, OP_SET_GLOBAL, OP_INC_GLOBAL, OP_DEC_GLOBAL,
+    OP_MODIFY_GLOBAL
+};
+
+static Konstant* findKonstant(Token* name) {
+    for (int i = 0; i < konstantCount; i++) {
+        if (identifiersEqual(name, &konstants[i].name)) {
+            return &konstants[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool isShadowed(Token* name);
+
+// The 'konst' a name refers to, unless a variable of the same name hides
+// it. Inlined bodies only see their own locals.
+static Konstant* resolveKonstant(Token* name) {
+    Konstant* konstant = findKonstant(name);
+    if (konstant == NULL) return NULL;
+
+    if (inlineSite != NULL) {
+        for (int i = current->localCount - 1; i >= inlineSite->localBase;
+             i--) {
+            if (identifiersEqual(name, &current->locals[i].name)) {
+                return NULL;
+            }
+        }
+        return konstant;
+    }
+
+    return isShadowed(name) ? NULL : konstant;
+}
+
+static void checkAssignable(Token* name) {
+    if (resolveKonstant(name) != NULL) {
+        error("Hindi maaaring palitan ang halaga ng konst.");
+    }
+}
+
+static int resolveVariable(Token* name, const VariableOps** ops) {
+    int arg = resolveLocal(current, name);
+    if (arg != -1) {
+        *ops = &localOps;
+        return arg;
+    }
+
+    if (inlineSite == NULL && (arg = resolveUpvalue(current, name)) != -1) {
+        bool isValue = current->enclosing != NULL &&
+            current->upvalues[arg].isValue;
+        *ops = isValue ? &capturedOps : &upvalueOps;
+        return arg;
+    }
+
+    *ops = &globalOps;
+    return identifierConstant(name);
+}
+
 static void postfixIncDec(int varIndex, uint8_t setOp) {
     ParseFn incRule = getRule(parser.current.type)->infix;
 
@@ -600,7 +1256,7 @@ static void postfixIncDec(int varIndex, uint8_t setOp) {
     emitByte(OP_DUP);              // <varUnchanged> <varUnchanged>
     emitConstant(NUMBER_VAL(1));   // <varUnchanged> <varUnchanged> 1
     incRule(false);                // <varUnchanged> <varUnchanged> 1 <++/-->
-    emitVariable(setOp, varIndex); // <varUnchanged> <varChanged>
+    emitOperand(setOp, varIndex); // <varUnchanged> <varChanged>
     emitByte(OP_POP);              // <varUnchanged>
     advance(); // Consume ++ or --.
 }
@@ -613,103 +1269,570 @@ static void prefixIncDec(TokenType operatorType) {
     emitConstant(NUMBER_VAL(1));   // <varUnchanged> 1
     incRule(false);                // <varUnchanged> 1 <++/-->
 
-    int arg = resolveLocal(current, &parser.previous);
-    uint8_t setOp;
-    if (arg != -1) {
-        setOp = OP_SET_LOCAL;
-    } else {
-        arg = identifierConstant(&parser.previous);
-        setOp = OP_SET_GLOBAL;
-    }
-    
-    emitVariable(setOp, arg);      // <varChanged>
+    checkAssignable(&parser.previous);
+    const VariableOps* ops;
+    int arg = resolveVariable(&parser.previous, &ops);
+    emitOperand(ops->set, arg);   // <varChanged>
 }
 
-static void namedVariable(Token name, bool canAssign) {
-    uint8_t getOp, setOp;
-    int arg = resolveLocal(current, &name);
-    if (arg != -1) {
-        getOp = OP_GET_LOCAL;
-        setOp = OP_SET_LOCAL;
-    } else if ((arg = resolveUpvalue(current, &name)) != -1 ) {
-        getOp = OP_GET_UPVALUE;
-        setOp = OP_SET_UPVALUE;
-    } else {
-        arg = identifierConstant(&name);
-        getOp = OP_GET_GLOBAL;
-        setOp = OP_SET_GLOBAL;
+static void emitInlineArgument(InlineArgument* argument) {
+    if (argument->slot != -1) {
+        emitOperand(OP_GET_LOCAL, argument->slot);
+        return;
     }
 
-    if (canAssign) {
-        if (match(TOKEN_KATUMBAS)) {
-            expression();
-            emitVariable(setOp, arg);
-        } else if (check(TOKEN_BAWAS_ISA) || check(TOKEN_DAGDAG_ISA)) {
-            emitVariable(getOp, arg);
-            postfixIncDec(arg, setOp);
-        } else {
-            emitVariable(getOp, arg);
+    Token* literal = &argument->literal;
+    switch (literal->type) {
+        case TOKEN_NUMERO: {
+            double value = strtod(literal->start, NULL);
+            emitValue(NUMBER_VAL(argument->isNegative ? -value : value));
+            break;
         }
-    } else {
-        emitVariable(getOp, arg);
+        case TOKEN_SALITA: emitValue(OBJ_VAL(parseString(literal))); break;
+        case TOKEN_MALI: emitValue(BOOL_VAL(false)); break;
+        case TOKEN_NULL: emitValue(NULL_VAL); break;
+        case TOKEN_TAMA: emitValue(BOOL_VAL(true)); break;
+        case TOKEN_PAGKAKAKILANLAN:
+            emitValue(resolveKonstant(literal)->value);
+            break;
+        default: return; // Unreachable.
     }
 }
 
-static void variable(bool canAssign) {
-    namedVariable(parser.previous, canAssign);
-}
+static bool inlineParameter(Token* name) {
+    InlineFunction* callee = inlineSite->callee;
+    for (int i = 0; i < callee->arity; i++) {
+        if (identifiersEqual(name, &callee->params[i])) {
+            emitInlineArgument(&inlineSite->arguments[i]);
+            return true;
+        }
+    }
 
-static Token syntheticToken(const char* text) {
-    Token token;
-    token.start = text;
-    token.length = (int)strlen(text);
-    return token;
+    return false;
 }
 
-static void super_(bool canAssign) {
-    if (currentClass == NULL) {
-        error("Hindi maaaring gamitin ang 'mula' sa labas ng uri.");
-    } else if (!currentClass->hasSuperclass) {
-        error("Hindi maaaring gamitin ang 'mula' sa uri na walang pinagmamanahan.");
+static bool matchesIndex(GuardedIndex* index, Token* tokens) {
+    Token* loopVariable = &current->locals[loopGuard->loopVariable].name;
+    TokenType operatorType = index->isSubtract ? TOKEN_BAWAS : TOKEN_DAGDAG;
+
+    if (!index->hasOffset) {
+        return identifiersEqual(&tokens[0], loopVariable) &&
+            tokens[1].type == TOKEN_KANANG_BRACKET;
     }
-     
-    consume(TOKEN_TULDOK, "Inaasahan na makakita ng '.' matapos ang 'mula'.");
-    consume(TOKEN_PAGKAKAKILANLAN, "Inaasahan ang pangalan ng gawain sa pinagmulang uri.");
-    uint8_t name = identifierConstant(&parser.previous);
 
-    namedVariable(syntheticToken("ito"), false);
-    if (match(TOKEN_KALIWANG_PAREN)) {
-        uint8_t argCount = argumentList();
-        namedVariable(syntheticToken("mula"), false);
-        emitBytes(OP_SUPER_INVOKE, name);
-        emitByte(argCount);
-    } else {
-        namedVariable(syntheticToken("mula"), false);
-        emitBytes(OP_GET_SUPER, name);
+    if (tokens[1].type != operatorType ||
+        tokens[3].type != TOKEN_KANANG_BRACKET) {
+        return false;
     }
-}
 
-static void this_(bool canAssign) {
-    if (currentClass == NULL) {
-        error("Hindi maaaring gamitin ang 'ito' sa labas ng uri.");
-        return;
+    if (identifiersEqual(&tokens[0], loopVariable)) {
+        return identifiersEqual(&tokens[2], &index->offset);
     }
 
-    variable(false);
+    return !index->isSubtract &&
+        identifiersEqual(&tokens[0], &index->offset) &&
+        identifiersEqual(&tokens[2], loopVariable);
 }
 
-static void unary(bool canAssign) {
-    TokenType operatorType = parser.previous.type;
+// Whether the '[' that comes next indexes the array with one of the
+// indexes checked in front of the current loop.
+static bool isGuardedIndex(Token* array) {
+    if (loopGuard == NULL || !check(TOKEN_KALIWANG_BRACKET)) return false;
 
-    // Compile the operand.
-    parsePrecedence(PREC_UNARY);
+    Scanner scannerState = saveScanner();
+    Token tokens[4];
+    for (int i = 0; i < 4; i++) tokens[i] = scanToken();
+    restoreScanner(scannerState);
 
-    // Emit the operator instruction.
-    switch (operatorType) {
-        case TOKEN_HINDI: emitByte(OP_NOT); break;
-        case TOKEN_BAWAS: emitByte(OP_NEGATE); break;
-        case TOKEN_BAWAS_ISA:
-        case TOKEN_DAGDAG_ISA: {
+    for (int i = 0; i < loopGuard->indexCount; i++) {
+        GuardedIndex* index = &loopGuard->indexes[i];
+        if (identifiersEqual(array, &index->array) &&
+            matchesIndex(index, tokens)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void namedVariable(Token name, bool canAssign) {
+    if (inlineSite != NULL && inlineSite->arguments != NULL &&
+        inlineParameter(&name)) {
+        return;
+    }
+
+    Konstant* konstant = resolveKonstant(&name);
+    if (konstant != NULL) {
+        if (canAssign && (check(TOKEN_KATUMBAS) || check(TOKEN_DAGDAG_ISA) ||
+                          check(TOKEN_BAWAS_ISA) ||
+                          check(TOKEN_DAGDAG_KATUMBAS) ||
+                          check(TOKEN_BAWAS_KATUMBAS) ||
+                          check(TOKEN_BITUIN_KATUMBAS) ||
+                          check(TOKEN_SULONG_PAHILIS_KATUMBAS))) {
+            error("Hindi maaaring palitan ang halaga ng konst.");
+        }
+
+        emitValue(konstant->value);
+        return;
+    }
+
+    const VariableOps* ops;
+    int arg = resolveVariable(&name, &ops);
+
+    uint8_t operation;
+    if (canAssign && match(TOKEN_KATUMBAS)) {
+        expression();
+        emitOperand(ops->set, arg);
+    } else if (canAssign && matchCompound(&operation)) {
+        expression();
+        emitOperand(ops->modify, arg);
+        emitByte(operation);
+    } else if (canAssign &&
+               (check(TOKEN_BAWAS_ISA) || check(TOKEN_DAGDAG_ISA))) {
+        emitOperand(ops->get, arg);
+        postfixIncDec(arg, ops->set);
+    } else {
+        emitOperand(ops->get, arg);
+        isGuardedElement = isGuardedIndex(&name);
+    }
+}
+
+static Token syntheticToken(const char* text) {
+    Token token;
+    token.start = text;
+    token.length = (int)strlen(text);
+    return token;
+}
+
+static bool isShadowed(Token* name) {
+    for (Compiler* compiler = current; compiler != NULL;
+         compiler = compiler->enclosing) {
+        for (int i = compiler->localCount - 1; i >= 0; i--) {
+            if (identifiersEqual(name, &compiler->locals[i].name)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static InlineFunction* findInlineFunction(Token* name) {
+    for (int i = 0; i < inlineFunctionCount; i++) {
+        if (identifiersEqual(name, &inlineFunctions[i].name)) {
+            return &inlineFunctions[i];
+        }
+    }
+
+    return NULL;
+}
+
+static InlineFunction* inlineTarget(Token* name) {
+    // Bodies are not inlined into other inlined bodies.
+    if (inlineSite != NULL) return NULL;
+
+    InlineFunction* function = findInlineFunction(name);
+    if (function == NULL || !function->isDeclared ||
+        function->isReassigned || isShadowed(name)) {
+        return NULL;
+    }
+
+    return function;
+}
+
+static void inlineBody(InlineSite* site) {
+    Scanner scannerState = saveScanner();
+    Token currentToken = parser.current;
+    Token previousToken = parser.previous;
+
+    inlineSite = site;
+    int start = currentChunk()->count;
+    restoreScanner(site->callee->body);
+    advance();
+
+    if (site->callee->isExpression) {
+        advance(); // Skip 'ibalik'.
+        expression();
+    } else {
+        while (!check(TOKEN_KANANG_BRACE) && !check(TOKEN_DULO)) {
+            declaration();
+        }
+    }
+
+    inlineSite = NULL;
+    restoreScanner(scannerState);
+    parser.current = currentToken;
+    parser.previous = previousToken;
+    current->inlinedCalls++;
+
+    Token* name = &site->callee->name;
+    addInlinedCall(currentChunk(), start, previousToken.line,
+                   copyString(name->start, name->length));
+}
+
+static bool simpleArgument(InlineFunction* callee, Token* token,
+                           InlineArgument* argument) {
+    argument->slot = -1;
+    argument->literal = *token;
+
+    switch (token->type) {
+        case TOKEN_NUMERO:
+            return true;
+        case TOKEN_SALITA:
+        case TOKEN_TAMA:
+        case TOKEN_MALI:
+        case TOKEN_NULL:
+            return !argument->isNegative;
+        case TOKEN_PAGKAKAKILANLAN:
+            if (!argument->isNegative && resolveKonstant(token) != NULL) {
+                return true;
+            }
+
+            // A call in the body could change the local between two reads.
+            if (argument->isNegative || callee->hasCall) return false;
+
+            for (int i = current->localCount - 1; i >= 0; i--) {
+                Local* local = &current->locals[i];
+                if (identifiersEqual(token, &local->name)) {
+                    if (local->depth == -1) return false;
+                    argument->slot = i;
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// Inside an expression the stack may hold temporaries above the locals, so
+// an 'ibalik <ekspresyon>;' body is inlined only when every argument is a
+// literal or a local that can be read again wherever its parameter appears.
+static bool inlineCall(Token* name) {
+    InlineFunction* callee = inlineTarget(name);
+    if (callee == NULL || !callee->isExpression || callee->hasAssignment) {
+        return false;
+    }
+
+    InlineArgument arguments[MAX_INLINE_PARAMS];
+    int argCount = 0;
+    bool isSimple = true;
+
+    Scanner scannerState = saveScanner();
+    Token token = scanToken();
+    if (token.type != TOKEN_KANANG_PAREN) {
+        for (;;) {
+            if (argCount == callee->arity) {
+                isSimple = false;
+                break;
+            }
+
+            InlineArgument* argument = &arguments[argCount++];
+            argument->isNegative = token.type == TOKEN_BAWAS;
+            if (argument->isNegative) token = scanToken();
+
+            if (!simpleArgument(callee, &token, argument)) {
+                isSimple = false;
+                break;
+            }
+
+            token = scanToken();
+            if (token.type == TOKEN_KANANG_PAREN) break;
+            if (token.type != TOKEN_KUWIT) {
+                isSimple = false;
+                break;
+            }
+            token = scanToken();
+        }
+    }
+    restoreScanner(scannerState);
+
+    if (!isSimple || argCount != callee->arity) return false;
+
+    // The arguments were already read above.
+    while (parser.previous.type != TOKEN_KANANG_PAREN) advance();
+
+    InlineSite site = {callee, current->localCount, arguments};
+    inlineBody(&site);
+    return true;
+}
+
+// A call standing alone as a statement has nothing above the locals on the
+// stack, so its arguments can be kept in new locals named after the
+// parameters and any small body can be inlined.
+static bool inlineCallStatement() {
+    if (!check(TOKEN_PAGKAKAKILANLAN)) return false;
+
+    InlineFunction* callee = inlineTarget(&parser.current);
+    if (callee == NULL) return false;
+
+    // Look ahead for 'pangalan(...);' and count the arguments.
+    Scanner scannerState = saveScanner();
+    bool isCallStatement = false;
+    int argCount = 0;
+    int depth = 0;
+
+    if (scanToken().type == TOKEN_KALIWANG_PAREN) {
+        for (Token token = scanToken(); token.type != TOKEN_DULO;
+             token = scanToken()) {
+            bool isOpening = token.type == TOKEN_KALIWANG_PAREN ||
+                             token.type == TOKEN_KALIWANG_BRACKET ||
+                             token.type == TOKEN_KALIWANG_BRACE;
+            bool isClosing = token.type == TOKEN_KANANG_PAREN ||
+                             token.type == TOKEN_KANANG_BRACKET ||
+                             token.type == TOKEN_KANANG_BRACE;
+
+            if (isClosing && depth == 0) {
+                isCallStatement = token.type == TOKEN_KANANG_PAREN &&
+                    scanToken().type == TOKEN_TULDOK_KUWIT;
+                break;
+            }
+
+            if (argCount == 0) argCount = 1;
+            if (isOpening) {
+                depth++;
+            } else if (isClosing) {
+                depth--;
+            } else if (token.type == TOKEN_KUWIT && depth == 0) {
+                argCount++;
+            }
+        }
+    }
+    restoreScanner(scannerState);
+
+    if (!isCallStatement || argCount != callee->arity) return false;
+
+    advance(); // The name.
+    advance(); // The '('.
+
+    beginScope();
+    int localBase = current->localCount;
+    for (int i = 0; i < argCount; i++) {
+        expression();
+        addLocal(syntheticToken(""));
+        markInitialized();
+        match(TOKEN_KUWIT);
+    }
+    consume(TOKEN_KANANG_PAREN, 
+        "Inaasahan na makakita ng ')' matapos ang mga argumento.");
+    consume(TOKEN_TULDOK_KUWIT, 
+        "Inasahan na makakita ng ';' pagtapos ng ekspresyon.");
+
+    // Named only now so that later arguments still see the caller's
+    // variables.
+    for (int i = 0; i < argCount; i++) {
+        current->locals[localBase + i].name = callee->params[i];
+    }
+
+    InlineSite site = {callee, localBase, NULL};
+    inlineBody(&site);
+    if (callee->isExpression) emitByte(OP_POP);
+
+    endScope();
+    return true;
+}
+
+// Scans the whole script once for the names that are declared or assigned
+// anywhere in it.
+static void findWrittenNames() {
+    // Set first so the GC marks the names while they are added.
+    initTable(&writtenNames);
+    hasWrittenNames = true;
+
+    Scanner scannerState = saveScanner();
+    initScanner(scriptSource);
+
+    TokenType before = TOKEN_TULDOK_KUWIT;
+    Token token = scanToken();
+    while (token.type != TOKEN_DULO) {
+        Token after = scanToken();
+        if (token.type == TOKEN_PAGKAKAKILANLAN && before != TOKEN_TULDOK &&
+            (before == TOKEN_GAWAIN || before == TOKEN_KILALANIN ||
+             before == TOKEN_URI || before == TOKEN_KONST ||
+             before == TOKEN_DAGDAG_ISA || before == TOKEN_BAWAS_ISA ||
+             isAssignmentToken(after.type))) {
+            ObjString* name = copyString(token.start, token.length);
+            push(OBJ_VAL(name));
+            tableSet(&writtenNames, name, BOOL_VAL(true));
+            pop();
+        }
+        before = token.type;
+        token = after;
+    }
+
+    restoreScanner(scannerState);
+}
+
+// Whether a global with the given name is declared or assigned anywhere
+// in the script.
+static bool isGlobalWritten(Token* name) {
+    if (!hasWrittenNames) findWrittenNames();
+
+    Value value;
+    ObjString* string = copyString(name->start, name->length);
+    return tableGet(&writtenNames, string, &value);
+}
+
+// The native a name refers to if it is marked pure. Only the script as a
+// whole can tell that the name is never given another value, so functions
+// compiled lazily on their own don't fold.
+static ObjNative* pureNative(Token* name) {
+    if (scriptSource == NULL || inlineSite != NULL || isShadowed(name)) {
+        return NULL;
+    }
+
+    Value value;
+    ObjString* string = copyString(name->start, name->length);
+    if (!tableGet(&vm.globals, string, &value) || !IS_NATIVE(value)) {
+        return NULL;
+    }
+
+    // One that could call back into the script would run it half compiled.
+    ObjNative* native = (ObjNative*)AS_OBJ(value);
+    if (!(native->flags & NATIVE_PURE) || native->flags & NATIVE_REENTER) {
+        return NULL;
+    }
+    return native;
+}
+
+// A call to a pure native with only constant arguments is made while
+// compiling and replaced by its result.
+static bool nativeCall(Token* name) {
+    ObjNative* native = pureNative(name);
+    if (native == NULL) return false;
+
+    int start = currentChunk()->count;
+    namedVariable(*name, false);
+    advance(); // The '('.
+
+    Value args[UINT8_COUNT];
+    bool isConstant = true;
+    uint8_t argCount = 0;
+    if (!check(TOKEN_KANANG_PAREN)) {
+        do {
+            int argumentStart = currentChunk()->count;
+            expression();
+
+            Value value;
+            int valueStart;
+            // NaN and infinities are left to the VM, so that a native that
+            // mishandles them can't bring down the compiler.
+            if (!lastConstant(&value, &valueStart) ||
+                valueStart != argumentStart ||
+                (IS_OBJ(value) && !IS_STRING(value)) ||
+                (IS_NUMBER(value) && !isfinite(AS_NUMBER(value)))) {
+                isConstant = false;
+            } else {
+                args[argCount] = value;
+            }
+
+            if (argCount == 255) {
+                error("Hindi maaaring magkaroon ng higit sa 255 na mga argumento");
+            }
+            argCount++;
+        } while (match(TOKEN_KUWIT));
+    }
+    consume(TOKEN_KANANG_PAREN,
+        "Inaasahan na makakita ng ')' matapos ang mga argumento.");
+
+    // Arguments its check turns down are left for the VM to report.
+    if (!isConstant || parser.hadError || argCount < native->minArity ||
+        argCount > native->maxArity || isGlobalWritten(name) ||
+        (native->check != NULL && native->check(argCount, args) != NULL)) {
+        emitCall(argCount);
+        return true;
+    }
+
+    // A native that allocates may trigger the GC, which only sees the
+    // arguments on the VM's stack.
+    Value result;
+    if (native->flags & NATIVE_ALLOCATE) {
+        for (int i = 0; i < argCount; i++) push(args[i]);
+        result = native->function(argCount, vm.stackTop - argCount);
+        vm.stackTop -= argCount;
+    } else {
+        result = native->function(argCount, args);
+    }
+
+    if (IS_OBJ(result) && !IS_STRING(result)) {
+        emitCall(argCount);
+        return true;
+    }
+
+    push(result);
+    rewindChunk(start);
+    emitValue(result);
+    pop();
+    return true;
+}
+
+static void variable(bool canAssign) {
+    if (check(TOKEN_KALIWANG_PAREN) && inlineCall(&parser.previous)) return;
+    if (check(TOKEN_KALIWANG_PAREN) && nativeCall(&parser.previous)) return;
+    namedVariable(parser.previous, canAssign);
+}
+
+static void super_(bool canAssign) {
+    if (currentClass == NULL) {
+        error("Hindi maaaring gamitin ang 'mula' sa labas ng uri.");
+    } else if (!currentClass->hasSuperclass) {
+        error("Hindi maaaring gamitin ang 'mula' sa uri na walang pinagmamanahan.");
+    }
+     
+    consume(TOKEN_TULDOK, "Inaasahan na makakita ng '.' matapos ang 'mula'.");
+    consume(TOKEN_PAGKAKAKILANLAN, "Inaasahan ang pangalan ng gawain sa pinagmulang uri.");
+    int name = identifierConstant(&parser.previous);
+
+    namedVariable(syntheticToken("ito"), false);
+    if (match(TOKEN_KALIWANG_PAREN)) {
+        uint8_t argCount = argumentList();
+        namedVariable(syntheticToken("mula"), false);
+        emitOperand(OP_SUPER_INVOKE, name);
+        emitByte(argCount);
+    } else {
+        namedVariable(syntheticToken("mula"), false);
+        emitOperand(OP_GET_SUPER, name);
+    }
+}
+
+static void this_(bool canAssign) {
+    if (currentClass == NULL) {
+        error("Hindi maaaring gamitin ang 'ito' sa labas ng uri.");
+        return;
+    }
+
+    variable(false);
+}
+
+static void unary(bool canAssign) {
+    TokenType operatorType = parser.previous.type;
+
+    // Compile the operand.
+    parsePrecedence(PREC_UNARY);
+
+    Value operand;
+    int start;
+    if (lastConstant(&operand, &start)) {
+        if (operatorType == TOKEN_HINDI) {
+            rewindChunk(start);
+            emitValue(BOOL_VAL(IS_NULL(operand) ||
+                               (IS_BOOL(operand) && !AS_BOOL(operand))));
+            return;
+        }
+
+        if (operatorType == TOKEN_BAWAS && IS_NUMBER(operand)) {
+            rewindChunk(start);
+            emitValue(NUMBER_VAL(-AS_NUMBER(operand)));
+            return;
+        }
+    }
+
+    // Emit the operator instruction.
+    switch (operatorType) {
+        case TOKEN_HINDI: emitByte(OP_NOT); break;
+        case TOKEN_BAWAS: emitByte(OP_NEGATE); break;
+        case TOKEN_BAWAS_ISA:
+        case TOKEN_DAGDAG_ISA: {
             prefixIncDec(operatorType);
             break;
         }
@@ -720,7 +1843,7 @@ static void unary(bool canAssign) {
 ParseRule rules[] = {
     [TOKEN_KALIWANG_PAREN]   = {grouping,  call,      PREC_CALL},
     [TOKEN_KANANG_PAREN]     = {NULL,      NULL,      PREC_NONE},
-    [TOKEN_KALIWANG_BRACE]   = {NULL,      NULL,      PREC_NONE},
+    [TOKEN_KALIWANG_BRACE]   = {map,       NULL,      PREC_NONE},
     [TOKEN_KANANG_BRACE]     = {NULL,      NULL,      PREC_NONE},
     [TOKEN_KALIWANG_BRACKET] = {array,     element,   PREC_CALL},
     [TOKEN_KANANG_BRACKET]   = {NULL,      NULL,      PREC_NONE},
@@ -734,8 +1857,12 @@ ParseRule rules[] = {
     [TOKEN_MODULO]           = {NULL,      binary,    PREC_FACTOR},
     [TOKEN_BAWAS]            = {unary,     binary,    PREC_TERM},
     [TOKEN_BAWAS_ISA]        = {unary,     decrement, PREC_POST_INC},
+    [TOKEN_BAWAS_KATUMBAS]   = {NULL,      NULL,      PREC_NONE},
     [TOKEN_DAGDAG]           = {NULL,      binary,    PREC_TERM},
     [TOKEN_DAGDAG_ISA]       = {unary,     increment, PREC_POST_INC},
+    [TOKEN_DAGDAG_KATUMBAS]  = {NULL,      NULL,      PREC_NONE},
+    [TOKEN_BITUIN_KATUMBAS]  = {NULL,      NULL,      PREC_NONE},
+    [TOKEN_SULONG_PAHILIS_KATUMBAS] = {NULL, NULL,    PREC_NONE},
     [TOKEN_HINDI]            = {unary,     NULL,      PREC_NONE},
     [TOKEN_HINDI_PAREHO]     = {NULL,      binary,    PREC_EQUALITY},
     [TOKEN_KATUMBAS]         = {NULL,      NULL,      PREC_NONE},
@@ -759,6 +1886,7 @@ ParseRule rules[] = {
     [TOKEN_KADA]             = {NULL,      NULL,      PREC_NONE},
     [TOKEN_KAPAG]            = {NULL,      NULL,      PREC_NONE},
     [TOKEN_KILALANIN]        = {NULL,      NULL,      PREC_NONE},
+    [TOKEN_KONST]            = {NULL,      NULL,      PREC_NONE},
     [TOKEN_KUNDIMAN]         = {NULL,      NULL,      PREC_NONE},
     [TOKEN_KUNG]             = {NULL,      NULL,      PREC_NONE},
     [TOKEN_MALI]             = {literal,   NULL,      PREC_NONE},
@@ -790,7 +1918,8 @@ static void parsePrecedence(Precedence precedence) {
         infixRule(canAssign);
     }
 
-    if (canAssign && match(TOKEN_KATUMBAS)) {
+    uint8_t operation;
+    if (canAssign && (match(TOKEN_KATUMBAS) || matchCompound(&operation))) {
         error("Mali ang itinuturong lalagyan ng halaga.");
     }
 }
@@ -812,9 +1941,18 @@ static void block() {
         "Inaasahan na makakita ng '}' matapos ang mga pahayag.");
 }
 
-static void function(FunctionType type) {
-    Compiler compiler;
-    initCompiler(&compiler, type);
+static ObjFunction* functionBody(Compiler* compiler, FunctionType type,
+                                 bool longJumps) {
+    // Loops of the enclosing function cannot be continued or exited from
+    // inside this one.
+    int surroundingLoopStart = innermostLoopStart;
+    int surroundingLoopScopeDepth = innermostLoopDepth;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostLoopStart = -1;
+    innermostLoopDepth = 0;
+    innermostExitDepth = -1;
+
+    initCompiler(compiler, type, longJumps);
     beginScope();
 
     consume(TOKEN_KALIWANG_PAREN, 
@@ -825,7 +1963,7 @@ static void function(FunctionType type) {
             if (current->function->arity > 255) {
                 errorAtCurrent("Hindi maaaring magkaroon ng mahigit sa 255 na parametro.");
             }
-            uint8_t constant = parseVariable(
+            int constant = parseVariable(
                 "Inaasahan na makakita ng pangalan ng parametro.");
             defineVariable(constant);
         } while (match(TOKEN_KUWIT));
@@ -834,20 +1972,145 @@ static void function(FunctionType type) {
         "Inaasahan na makakita ng ')' matapos ang mga parametro.");
     consume(TOKEN_KALIWANG_BRACE, 
         "Inaasahan na makakita ng '{' bago ang mga pahayag sa gawain.");
+
+    // The parameters are in scope of the body only.
+    for (int i = 1; i < current->localCount; i++) {
+        current->locals[i].scope = currentPosition();
+    }
     block();
 
-    ObjFunction* function = endCompiler();
-    emitBytes(OP_CLOSURE, makeConstant(OBJ_VAL(function)));
+    innermostLoopStart = surroundingLoopStart;
+    innermostLoopDepth = surroundingLoopScopeDepth;
+    innermostExitDepth = surroundingExitDepth;
+    return endCompiler();
+}
+
+static void emitClosure(ObjFunction* function, int constant,
+                        Upvalue* upvalues) {
+    bool isLong = constant > UINT8_MAX;
+    for (int i = 0; i < function->upvalueCount; i++) {
+        if (upvalues[i].index > UINT8_MAX) isLong = true;
+    }
+
+    if (isLong) {
+        emitByte(OP_LONG_CLOSURE);
+        emitLong(constant);
+    } else {
+        emitBytes(OP_CLOSURE, (uint8_t)constant);
+    }
 
     for (int i = 0; i < function->upvalueCount; i++) {
-        emitByte(compiler.upvalues[i].isLocal ? 1 : 0);
-        emitByte(compiler.upvalues[i].index);
+        emitByte((upvalues[i].isLocal ? UPVALUE_LOCAL : 0) |
+                 (upvalues[i].isValue ? UPVALUE_VALUE : 0));
+        if (isLong) {
+            emitLong(upvalues[i].index);
+        } else {
+            emitByte((uint8_t)upvalues[i].index);
+        }
     }
 }
 
+static void captureLazily(Compiler* compiler, Token* name) {
+    ObjFunction* function = compiler->function;
+    int upvalue = resolveUpvalue(compiler, name);
+    if (upvalue == -1 || upvalue < function->upvalueNames.count) return;
+
+    Value upvalueName = OBJ_VAL(copyString(name->start, name->length));
+    push(upvalueName);
+    writeValueArray(&function->upvalueNames, upvalueName);
+    pop();
+}
+
+// Only scans the body at load time: for its extent, to keep its text until
+// the first call, and for names of variables of the enclosing functions,
+// which have to be captured now while they are still on the stack. Names
+// that turn out to be shadowed inside the body are captured needlessly.
+static void lazyFunction() {
+    ObjFunction* function = newFunction();
+    int constant = makeConstant(OBJ_VAL(function));
+    function->name = copyString(parser.previous.start,
+                                parser.previous.length);
+    function->line = parser.current.line;
+    const char* start = parser.current.start;
+
+    // Stands in for the compiler of the function while capturing.
+    Compiler compiler;
+    compiler.enclosing = current;
+    compiler.function = function;
+    compiler.type = TYPE_FUNCTION;
+    compiler.upvalues = NULL;
+    compiler.upvalueCapacity = 0;
+    compiler.isLazy = true;
+
+    consume(TOKEN_KALIWANG_PAREN, 
+        "Inaasahan na makakita ng '(' matapos ang pangalan ng gawain.");
+    if (!check(TOKEN_KANANG_PAREN)) {
+        do {
+            function->arity++;
+            if (function->arity > 255) {
+                errorAtCurrent("Hindi maaaring magkaroon ng mahigit sa 255 na parametro.");
+            }
+            consume(TOKEN_PAGKAKAKILANLAN,
+                "Inaasahan na makakita ng pangalan ng parametro.");
+        } while (match(TOKEN_KUWIT));
+    }
+    consume(TOKEN_KANANG_PAREN, 
+        "Inaasahan na makakita ng ')' matapos ang mga parametro.");
+    consume(TOKEN_KALIWANG_BRACE, 
+        "Inaasahan na makakita ng '{' bago ang mga pahayag sa gawain.");
+
+    int depth = 0;
+    while (!check(TOKEN_DULO) &&
+           (depth > 0 || !check(TOKEN_KANANG_BRACE))) {
+        if (check(TOKEN_KALIWANG_BRACE)) {
+            depth++;
+        } else if (check(TOKEN_KANANG_BRACE)) {
+            depth--;
+        } else if (check(TOKEN_PAGKAKAKILANLAN) &&
+                   parser.previous.type != TOKEN_TULDOK) {
+            captureLazily(&compiler, &parser.current);
+        }
+        advance();
+    }
+    consume(TOKEN_KANANG_BRACE, 
+        "Inaasahan na makakita ng '}' matapos ang mga pahayag.");
+
+    function->source = copyString(start,
+        (int)(parser.previous.start + parser.previous.length - start));
+
+    emitClosure(function, constant, compiler.upvalues);
+    FREE_ARRAY(Upvalue, compiler.upvalues, compiler.upvalueCapacity);
+}
+
+static void function(FunctionType type) {
+    // Methods stay eager since their bodies depend on the enclosing class,
+    // and so do functions that could use a 'konst'.
+    if (lazyBodies && type == TYPE_FUNCTION && currentClass == NULL &&
+        konstantCount == 0) {
+        lazyFunction();
+        return;
+    }
+
+    Scanner scannerState = saveScanner();
+    Parser parserState = parser;
+
+    Compiler compiler;
+    ObjFunction* function = functionBody(&compiler, type, false);
+    if (compiler.jumpOverflow && !parser.hadError) {
+        freeCompiler(&compiler);
+        restoreScanner(scannerState);
+        parser = parserState;
+        function = functionBody(&compiler, type, true);
+    }
+
+    int constant = makeConstant(OBJ_VAL(function));
+    emitClosure(function, constant, compiler.upvalues);
+    freeCompiler(&compiler);
+}
+
 static void method() {
     consume(TOKEN_PAGKAKAKILANLAN, "Inaasahan ang pangalan ng instansyang gawain.");
-    uint8_t constant = identifierConstant(&parser.previous);
+    int constant = identifierConstant(&parser.previous);
 
     FunctionType type = TYPE_METHOD;
     if (parser.previous.length == 3 &&
@@ -856,16 +2119,16 @@ static void method() {
     }
 
     function(type);
-    emitBytes(OP_METHOD, constant);
+    emitOperand(OP_METHOD, constant);
 }
 
 static void classDeclaration() {
     consume(TOKEN_PAGKAKAKILANLAN, "Inaasahan ang pangalan ng uri.");
     Token className = parser.previous;
-    uint8_t nameConstant = identifierConstant(&parser.previous);
+    int nameConstant = identifierConstant(&parser.previous);
     declareVariable();
 
-    emitBytes(OP_CLASS, nameConstant);
+    emitOperand(OP_CLASS, nameConstant);
     defineVariable(nameConstant);
 
     ClassCompiler classCompiler;
@@ -909,10 +2172,25 @@ static void classDeclaration() {
 }
 
 static void funDeclaration() {
-    uint8_t global = parseVariable("Inaasahan ang pangalan ng gawain.");
+    int global = parseVariable("Inaasahan ang pangalan ng gawain.");
+    Token name = parser.previous;
     markInitialized();
+
+    // The body can capture the function before it is stored.
+    if (current->scopeDepth > 0) {
+        current->locals[current->localCount - 1].isFinal = 0;
+    }
     function(TYPE_FUNCTION);
     defineVariable(global);
+
+    // Calls compiled from here on may use the body in place.
+    if (current->type == TYPE_SCRIPT && current->scopeDepth == 0 &&
+        !parser.hadError) {
+        InlineFunction* inlined = findInlineFunction(&name);
+        if (inlined != NULL && inlined->name.start == name.start) {
+            inlined->isDeclared = true;
+        }
+    }
 }
 
 static void declareArray() {
@@ -948,9 +2226,7 @@ static void declareArray() {
         error("Masyadong maraming koleksyon para sa isang pagkakakilanlan.");
     }
 
-    // MULTI_ARRAY needs the rightmost array on top of the stack since its values
-    // will be copied into the enclosing array.
-    emitByte(OP_DECLARE_ARRAY);
+    // All the sizes are on the stack for a single block of elements.
     emitBytes(OP_MULTI_ARRAY, (uint8_t)dimension);
 }
 
@@ -970,35 +2246,473 @@ static void varDeclaration() {
     defineVariable(global);
 }
 
+// 'i++', '++i' and their '--' forms whose value is not used change the
+// variable in place.
+static bool incrementStatement(TokenType terminator) {
+    Scanner scannerState = saveScanner();
+    Token name;
+    TokenType operatorType;
+    if (check(TOKEN_PAGKAKAKILANLAN)) {
+        name = parser.current;
+        operatorType = scanToken().type;
+    } else if (check(TOKEN_DAGDAG_ISA) || check(TOKEN_BAWAS_ISA)) {
+        operatorType = parser.current.type;
+        name = scanToken();
+    } else {
+        return false;
+    }
+
+    bool isIncrement = name.type == TOKEN_PAGKAKAKILANLAN &&
+        (operatorType == TOKEN_DAGDAG_ISA ||
+         operatorType == TOKEN_BAWAS_ISA) &&
+        scanToken().type == terminator;
+    restoreScanner(scannerState);
+    if (!isIncrement) return false;
+
+    advance();
+    advance();
+
+    checkAssignable(&name);
+    const VariableOps* ops;
+    int arg = resolveVariable(&name, &ops);
+    emitOperand(operatorType == TOKEN_DAGDAG_ISA ?
+                ops->increment : ops->decrement, arg);
+    return true;
+}
+
 static void expressionStatement() {
+    if (inlineCallStatement()) return;
+
+    if (incrementStatement(TOKEN_TULDOK_KUWIT)) {
+        consume(TOKEN_TULDOK_KUWIT, 
+            "Inasahan na makakita ng ';' pagtapos ng ekspresyon.");
+        return;
+    }
+
     expression();
     consume(TOKEN_TULDOK_KUWIT, 
         "Inasahan na makakita ng ';' pagtapos ng ekspresyon.");
     emitByte(OP_POP);
 }
 
-static void forStatement() {
-    beginScope();
+static bool isAssignmentToken(TokenType type) {
+    switch (type) {
+        case TOKEN_KATUMBAS:
+        case TOKEN_DAGDAG_KATUMBAS:
+        case TOKEN_BAWAS_KATUMBAS:
+        case TOKEN_BITUIN_KATUMBAS:
+        case TOKEN_SULONG_PAHILIS_KATUMBAS:
+        case TOKEN_DAGDAG_ISA:
+        case TOKEN_BAWAS_ISA:
+            return true;
+        default:
+            return false;
+    }
+}
 
-    int loopVariable = -1;
-    Token loopVariableName;
-    loopVariableName.start = NULL;
+static bool hasName(Token* names, int count, Token* name) {
+    for (int i = 0; i < count; i++) {
+        if (identifiersEqual(&names[i], name)) return true;
+    }
 
-    consume(TOKEN_KALIWANG_PAREN, 
-        "Inasahan na makakita ng '(' matapos ang 'kada'.");
-    if (match(TOKEN_TULDOK_KUWIT)) {
-        // No initializer.
-    } else if (match(TOKEN_KILALANIN)) {
-        loopVariableName = parser.current;
-        varDeclaration();
-        loopVariable = current->localCount - 1;
+    return false;
+}
+
+static bool addName(Token* names, int* count, Token* name) {
+    if (hasName(names, *count, name)) return true;
+    if (*count == MAX_LOOP_NAMES) return false;
+
+    names[(*count)++] = *name;
+    return true;
+}
+
+static bool isIndexOperand(Token* token, Token* loopVariable) {
+    return token->type == TOKEN_NUMERO ||
+        (token->type == TOKEN_PAGKAKAKILANLAN &&
+         !identifiersEqual(token, loopVariable));
+}
+
+// Records 'array[...]' if its index is one of the forms in GuardedIndex.
+static void scanIndex(LoopGuard* guard, Token* tokens, int remaining,
+                      Token* loopVariable) {
+    GuardedIndex index;
+    index.array = tokens[0];
+    index.hasOffset = false;
+    index.isSubtract = false;
+
+    Token* inner = &tokens[2];
+    remaining -= 2;
+    if (remaining >= 2 && identifiersEqual(&inner[0], loopVariable) &&
+        inner[1].type == TOKEN_KANANG_BRACKET) {
+        // a[i]
+    } else if (remaining >= 4 && inner[3].type == TOKEN_KANANG_BRACKET &&
+               identifiersEqual(&inner[0], loopVariable) &&
+               (inner[1].type == TOKEN_DAGDAG ||
+                inner[1].type == TOKEN_BAWAS) &&
+               isIndexOperand(&inner[2], loopVariable)) {
+        index.offset = inner[2];
+        index.hasOffset = true;
+        index.isSubtract = inner[1].type == TOKEN_BAWAS;
+    } else if (remaining >= 4 && inner[3].type == TOKEN_KANANG_BRACKET &&
+               isIndexOperand(&inner[0], loopVariable) &&
+               inner[1].type == TOKEN_DAGDAG &&
+               identifiersEqual(&inner[2], loopVariable)) {
+        index.offset = inner[0];
+        index.hasOffset = true;
     } else {
-        expressionStatement();
+        return;
+    }
+
+    if (guard->indexCount == MAX_LOOP_NAMES) return;
+    for (int i = 0; i < guard->indexCount; i++) {
+        GuardedIndex* other = &guard->indexes[i];
+        if (identifiersEqual(&other->array, &index.array) &&
+            other->hasOffset == index.hasOffset &&
+            other->isSubtract == index.isSubtract &&
+            (!index.hasOffset ||
+             identifiersEqual(&other->offset, &index.offset))) {
+            return;
+        }
+    }
+
+    guard->indexes[guard->indexCount++] = index;
+}
+
+// Only 'kada (...; i < n; i++)' and 'i <= n' with 'i++', '++i' or
+// 'i += 1' have bounds the guard can check.
+static bool scanBounds(LoopGuard* guard, Token* tokens, int headerEnd,
+                       Token* loopVariable) {
+    if (headerEnd < 6 || !identifiersEqual(&tokens[0], loopVariable) ||
+        (tokens[1].type != TOKEN_BABA &&
+         tokens[1].type != TOKEN_BABA_PAREHO) ||
+        !isIndexOperand(&tokens[2], loopVariable) ||
+        tokens[3].type != TOKEN_TULDOK_KUWIT) {
+        return false;
+    }
+
+    Token* increment = &tokens[4];
+    bool isStep = false;
+    if (headerEnd == 6) {
+        isStep = (identifiersEqual(&increment[0], loopVariable) &&
+                  increment[1].type == TOKEN_DAGDAG_ISA) ||
+                 (increment[0].type == TOKEN_DAGDAG_ISA &&
+                  identifiersEqual(&increment[1], loopVariable));
+    } else if (headerEnd == 7) {
+        isStep = identifiersEqual(&increment[0], loopVariable) &&
+            increment[1].type == TOKEN_DAGDAG_KATUMBAS &&
+            increment[2].type == TOKEN_NUMERO &&
+            strtod(increment[2].start, NULL) == 1;
+    }
+
+    guard->bound = tokens[2];
+    guard->isInclusive = tokens[1].type == TOKEN_BABA_PAREHO;
+    return isStep;
+}
+
+// Looks through the rest of a loop, from its condition up to the end of
+// its body, without compiling it. Loops that call anything, declare
+// functions or classes, hold another loop or have no block body are
+// compiled as they are.
+static bool scanLoop(LoopGuard* guard, int parenDepth, int loopVariable) {
+    Token tokens[LOOP_GUARD_MAX_TOKENS + 1];
+    int count = 0;
+    int headerEnd = -1;
+    int braceDepth = 0;
+    bool isComplete = false;
+
+    Scanner scannerState = saveScanner();
+    for (Token token = parser.current;
+         token.type != TOKEN_DULO && token.type != TOKEN_PROBLEMA &&
+         count < LOOP_GUARD_MAX_TOKENS;
+         token = scanToken()) {
+        tokens[count++] = token;
+
+        if (headerEnd == -1) {
+            if (token.type == TOKEN_KALIWANG_PAREN) {
+                parenDepth++;
+            } else if (token.type == TOKEN_KANANG_PAREN &&
+                       --parenDepth == 0) {
+                headerEnd = count - 1;
+            }
+        } else if (token.type == TOKEN_KALIWANG_BRACE) {
+            braceDepth++;
+        } else if (token.type == TOKEN_KANANG_BRACE && --braceDepth == 0) {
+            isComplete = true;
+            break;
+        } else if (braceDepth == 0) {
+            break;
+        }
+    }
+    restoreScanner(scannerState);
+
+    if (!isComplete) return false;
+
+    Token reads[MAX_LOOP_NAMES];
+    Token writes[MAX_LOOP_NAMES];
+    int readCount = 0;
+    int writeCount = 0;
+    bool hasBounds = loopVariable != -1;
+    Token* loopVariableName = hasBounds ?
+        &current->locals[loopVariable].name : NULL;
+    guard->indexCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        TokenType previous = i > 0 ? tokens[i - 1].type : TOKEN_PROBLEMA;
+        TokenType next = tokens[i + 1 < count ? i + 1 : i].type;
+
+        switch (tokens[i].type) {
+            case TOKEN_GAWAIN:
+            case TOKEN_URI:
+            case TOKEN_KADA:
+            case TOKEN_HABANG:
+            case TOKEN_GAWIN:
+                return false;
+            case TOKEN_KALIWANG_PAREN:
+                if (previous == TOKEN_PAGKAKAKILANLAN ||
+                    previous == TOKEN_KANANG_PAREN ||
+                    previous == TOKEN_KANANG_BRACKET) {
+                    return false;
+                }
+                break;
+            case TOKEN_PAGKAKAKILANLAN: {
+                if (previous == TOKEN_TULDOK) break; // A property.
+
+                Token* name = &tokens[i];
+                if (i >= 2 && tokens[i - 2].type == TOKEN_KILALANIN &&
+                    name->length == 2 && memcmp(name->start, "sa", 2) == 0) {
+                    break; // kada (kilalanin x sa ...)
+                }
+                if (previous != TOKEN_KILALANIN &&
+                    resolveKonstant(name) != NULL) {
+                    break; // Compiled as its value.
+                }
+
+                bool isWrite = isAssignmentToken(next) ||
+                    previous == TOKEN_DAGDAG_ISA ||
+                    previous == TOKEN_BAWAS_ISA ||
+                    previous == TOKEN_KILALANIN;
+                if (isWrite ? !addName(writes, &writeCount, name) :
+                              !addName(reads, &readCount, name)) {
+                    return false;
+                }
+
+                if (hasBounds && i > headerEnd) {
+                    if (isWrite && identifiersEqual(name, loopVariableName)) {
+                        hasBounds = false;
+                    } else if (next == TOKEN_KALIWANG_BRACKET) {
+                        scanIndex(guard, name, count - i, loopVariableName);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // Anything assigned inside the loop is read again on every use.
+    guard->hoistedCount = 0;
+    for (int i = 0; i < readCount; i++) {
+        if (!hasName(writes, writeCount, &reads[i])) {
+            guard->hoisted[guard->hoistedCount++] = reads[i];
+        }
+    }
+
+    if (hasBounds) {
+        hasBounds = scanBounds(guard, tokens, headerEnd, loopVariableName) &&
+            !hasName(writes, writeCount, &guard->bound);
+    }
+
+    guard->loopVariable = -1;
+    if (!hasBounds) {
+        guard->indexCount = 0;
+        return true;
+    }
+
+    int indexCount = 0;
+    for (int i = 0; i < guard->indexCount; i++) {
+        GuardedIndex* index = &guard->indexes[i];
+        if (!hasName(writes, writeCount, &index->array) &&
+            (!index->hasOffset ||
+             !hasName(writes, writeCount, &index->offset))) {
+            guard->indexes[indexCount++] = *index;
+        }
+    }
+    guard->indexCount = indexCount;
+    if (indexCount > 0) guard->loopVariable = loopVariable;
+    return true;
+}
+
+static void emitGuardValue(Token* token) {
+    if (token->type == TOKEN_NUMERO) {
+        emitNumber(strtod(token->start, NULL));
+        return;
+    }
+
+    Konstant* konstant = resolveKonstant(token);
+    if (konstant != NULL) {
+        emitValue(konstant->value);
+        return;
+    }
+
+    const VariableOps* ops;
+    int arg = resolveVariable(token, &ops);
+    emitOperand(ops->get, arg);
+}
+
+static void forLoop(int loopVariable, Token loopVariableName);
+static void whileLoop();
+
+static void compileLoop(TokenType loopType, int loopVariable,
+                        Token loopVariableName) {
+    if (loopType == TOKEN_KADA) {
+        forLoop(loopVariable, loopVariableName);
+    } else {
+        whileLoop();
+    }
+}
+
+// Compiles the loop with its invariant globals and upvalues read once
+// into locals and its checked indexes using the unchecked element
+// instructions. If a guard in front of it can fail, such as a global that
+// is not defined yet or an index that could leave the array, the loop is
+// compiled a second time as it is for the guard to jump to.
+static void guardedLoop(TokenType loopType, int loopVariable,
+                        Token loopVariableName) {
+    LoopGuard guard;
+    if (loopGuard != NULL || inlineSite != NULL ||
+        !scanLoop(&guard, loopType == TOKEN_KADA ? 1 : 0, loopVariable)) {
+        compileLoop(loopType, loopVariable, loopVariableName);
+        return;
+    }
+
+    int guardJumps[MAX_LOOP_NAMES * 2];
+    int jumpCount = 0;
+
+    // Locals are already as fast as they can be.
+    int hoistedCount = 0;
+    for (int i = 0; i < guard.hoistedCount; i++) {
+        const VariableOps* ops;
+        int arg = resolveVariable(&guard.hoisted[i], &ops);
+        if (ops == &localOps) continue;
+
+        guard.hoisted[hoistedCount++] = guard.hoisted[i];
+        if (ops == &globalOps) {
+            emitOperand(OP_DEFINED, arg);
+            guardJumps[jumpCount++] = emitJump(OP_JUMP_IF_FALSE);
+            emitByte(OP_POP);
+        }
+    }
+    guard.hoistedCount = hoistedCount;
+
+    for (int i = 0; i < guard.indexCount; i++) {
+        GuardedIndex* index = &guard.indexes[i];
+        emitGuardValue(&index->array);
+        emitOperand(OP_GET_LOCAL, guard.loopVariable);
+        emitGuardValue(&guard.bound);
+        if (index->hasOffset) {
+            emitGuardValue(&index->offset);
+        } else {
+            emitNumber(0);
+        }
+
+        uint8_t flags = 0;
+        if (guard.isInclusive) flags |= RANGE_INCLUSIVE;
+        if (index->isSubtract) flags |= RANGE_SUBTRACT;
+        emitBytes(OP_CHECK_RANGE, flags);
+        guardJumps[jumpCount++] = emitJump(OP_JUMP_IF_FALSE);
+        emitByte(OP_POP);
+    }
+
+    if (guard.hoistedCount == 0 && guard.indexCount == 0) {
+        compileLoop(loopType, loopVariable, loopVariableName);
+        return;
     }
 
-    int surroundingLoopExitCount = innermostLoopExitCount == -1 ?
-                                     0 : innermostLoopExitCount;
-    innermostLoopExitCount = 0;
+    Scanner scannerState = saveScanner();
+    Parser parserState = parser;
+
+    beginScope();
+    for (int i = 0; i < guard.hoistedCount; i++) {
+        emitGuardValue(&guard.hoisted[i]);
+        addLocal(guard.hoisted[i]);
+        markInitialized();
+    }
+
+    loopGuard = &guard;
+    compileLoop(loopType, loopVariable, loopVariableName);
+    loopGuard = NULL;
+    endScope();
+
+    if (jumpCount == 0 || parser.hadError) return;
+
+    int endJump = emitJump(OP_JUMP);
+    for (int i = 0; i < jumpCount; i++) {
+        patchJump(guardJumps[i]);
+    }
+    emitByte(OP_POP);
+
+    restoreScanner(scannerState);
+    parser = parserState;
+    compileLoop(loopType, loopVariable, loopVariableName);
+
+    patchJump(endJump);
+}
+
+// Looks ahead through the body of the loop for the name after a 'gawain'
+// or 'uri', where a closure could capture it. A block body ends at its
+// closing brace and any other body at its first ';' outside of brackets,
+// which can reach past a 'kung' with a block in it but never stops short.
+static bool isCapturedInBody(Token* name) {
+    Scanner scannerState = saveScanner();
+    restoreScanner(currentPosition());
+
+    bool isBlock = check(TOKEN_KALIWANG_BRACE);
+    bool inFunction = false;
+    bool isCaptured = false;
+    int depth = 0;
+    TokenType previous = TOKEN_PROBLEMA;
+    Token token = scanToken();
+    while (!isCaptured && token.type != TOKEN_DULO) {
+        switch (token.type) {
+            case TOKEN_KALIWANG_BRACE:
+            case TOKEN_KALIWANG_PAREN:
+            case TOKEN_KALIWANG_BRACKET:
+                depth++;
+                break;
+            case TOKEN_KANANG_BRACE:
+            case TOKEN_KANANG_PAREN:
+            case TOKEN_KANANG_BRACKET:
+                depth--;
+                break;
+            case TOKEN_GAWAIN:
+            case TOKEN_URI:
+                inFunction = true;
+                break;
+            case TOKEN_PAGKAKAKILANLAN:
+                isCaptured = inFunction && previous != TOKEN_TULDOK &&
+                             identifiersEqual(&token, name);
+                break;
+            default:
+                break;
+        }
+
+        if (depth < 0) break;
+        if (depth == 0 && (isBlock || token.type == TOKEN_TULDOK_KUWIT)) {
+            break;
+        }
+        previous = token.type;
+        token = scanToken();
+    }
+
+    restoreScanner(scannerState);
+    return isCaptured;
+}
+
+static void forLoop(int loopVariable, Token loopVariableName) {
+    int surroundingLoopExitCount = innermostLoopExitCount;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostExitDepth = current->scopeDepth;
 
     int surroundingLoopStart = innermostLoopStart;
     int surroundingLoopScopeDepth = innermostLoopDepth;
@@ -1019,8 +2733,10 @@ static void forStatement() {
     if (!match(TOKEN_KANANG_PAREN)) {
         int bodyJump = emitJump(OP_JUMP);
         int incrementStart = currentChunk()->count;
-        expression();
-        emitByte(OP_POP);
+        if (!incrementStatement(TOKEN_KANANG_PAREN)) {
+            expression();
+            emitByte(OP_POP);
+        }
         consume(TOKEN_KANANG_PAREN, 
             "Inasahan na makakita ng ')' matapos ang mga payahag sa 'kada'.");
 
@@ -1029,22 +2745,24 @@ static void forStatement() {
         patchJump(bodyJump);
     }
 
-    int innerVariable = -1;
-    if (loopVariable != -1) {
+    // A closure made in the body needs its own copy of the loop variable
+    // for each iteration.
+    if (loopVariable != -1 && isCapturedInBody(&loopVariableName)) {
         beginScope();
-        emitBytes(OP_GET_LOCAL, (uint8_t)loopVariable);
+        emitOperand(OP_GET_LOCAL, loopVariable);
         addLocal(loopVariableName);
         markInitialized();
-        innerVariable = current->localCount - 1;
-    }
+        int innerVariable = current->localCount - 1;
 
-    statement();
-    if (loopVariable != -1) {
-        emitBytes(OP_GET_LOCAL, (uint8_t)innerVariable);
-        emitBytes(OP_SET_LOCAL, (uint8_t)loopVariable);
+        statement();
+
+        emitOperand(OP_GET_LOCAL, innerVariable);
+        emitOperand(OP_SET_LOCAL, loopVariable);
         emitByte(OP_POP);
 
         endScope();
+    } else {
+        statement();
     }
 
     emitLoop(innermostLoopStart);
@@ -1054,17 +2772,94 @@ static void forStatement() {
         emitByte(OP_POP); // Condition.
     }
 
-    for (int i = surroundingLoopExitCount; 
-         i < innermostLoopExitCount + surroundingLoopExitCount; 
-         i++) {
-        patchJump(innermostLoopExits[i]);
-    }
+    patchExits(surroundingLoopExitCount);
+    innermostExitDepth = surroundingExitDepth;
+    innermostLoopStart = surroundingLoopStart;
+    innermostLoopDepth = surroundingLoopScopeDepth;
+}
+
+// Checks for 'kilalanin x sa' without consuming anything. 'sa' is only
+// special here so it can still be used as a name elsewhere.
+static bool isForEach() {
+    if (!check(TOKEN_PAGKAKAKILANLAN)) return false;
+
+    Scanner scannerState = saveScanner();
+    Token next = scanToken();
+    restoreScanner(scannerState);
+
+    return next.type == TOKEN_PAGKAKAKILANLAN && next.length == 2 &&
+           memcmp(next.start, "sa", 2) == 0;
+}
+
+// The collection and the position of its next element are kept as hidden
+// locals, while the loop variable is a new local on each step so closures
+// in the body capture their own element.
+static void forEachLoop() {
+    Token name = parser.current;
+    advance(); // The loop variable.
+    advance(); // 'sa'
+    expression();
+    consume(TOKEN_KANANG_PAREN,
+        "Inasahan na makakita ng ')' matapos ang koleksyon sa 'kada'.");
+
+    addLocal(syntheticToken(""));
+    markInitialized();
+    emitByte(OP_ITERATOR);
+    addLocal(syntheticToken(""));
+    markInitialized();
+
+    int surroundingLoopExitCount = innermostLoopExitCount;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostExitDepth = current->scopeDepth;
+
+    int surroundingLoopStart = innermostLoopStart;
+    int surroundingLoopScopeDepth = innermostLoopDepth;
+    innermostLoopStart = currentChunk()->count;
+    innermostLoopDepth = current->scopeDepth;
+
+    int exitJump = emitJump(OP_FOR_EACH);
+
+    beginScope();
+    addLocal(name);
+    markInitialized();
+    statement();
+    endScope();
+
+    emitLoop(innermostLoopStart);
+    patchJump(exitJump);
 
-    // ExitCount also acts as state so 0 count should be -1.
-    innermostLoopExitCount = surroundingLoopExitCount == 0 ?
-                               -1 : surroundingLoopExitCount;
+    patchExits(surroundingLoopExitCount);
+    innermostExitDepth = surroundingExitDepth;
     innermostLoopStart = surroundingLoopStart;
     innermostLoopDepth = surroundingLoopScopeDepth;
+}
+
+static void forStatement() {
+    beginScope();
+
+    int loopVariable = -1;
+    Token loopVariableName;
+    loopVariableName.start = NULL;
+
+    consume(TOKEN_KALIWANG_PAREN, 
+        "Inasahan na makakita ng '(' matapos ang 'kada'.");
+    if (match(TOKEN_TULDOK_KUWIT)) {
+        // No initializer.
+    } else if (match(TOKEN_KILALANIN)) {
+        if (isForEach()) {
+            forEachLoop();
+            endScope();
+            return;
+        }
+
+        loopVariableName = parser.current;
+        varDeclaration();
+        loopVariable = current->localCount - 1;
+    } else {
+        expressionStatement();
+    }
+
+    guardedLoop(TOKEN_KADA, loopVariable, loopVariableName);
 
     endScope();
 }
@@ -1089,26 +2884,224 @@ static void ifStatement() {
     patchJump(elseJump);
 }
 
-static void switchStatement() {
-    consume(TOKEN_KALIWANG_PAREN, 
-        "Inasahan na makakita ng '(' matapos ang 'suriin'.");
-    expression();
-    current->localCount++; // Offset +1 to the stack pointer.
-    consume(TOKEN_KANANG_PAREN, 
-        "Inasahan na makakita ng ')' matapos ang ekspresyon.");
+typedef enum {
+    SWITCH_CHAIN,
+    SWITCH_DENSE,
+    SWITCH_HASH
+} SwitchKind;
+
+// The value of a 'kapag' label that is a literal or a 'konst'.
+static bool literalValue(Token* token, Value* value) {
+    switch (token->type) {
+        case TOKEN_NUMERO:
+            *value = NUMBER_VAL(strtod(token->start, NULL));
+            return true;
+        case TOKEN_SALITA: *value = OBJ_VAL(parseString(token)); return true;
+        case TOKEN_TAMA:   *value = BOOL_VAL(true); return true;
+        case TOKEN_MALI:   *value = BOOL_VAL(false); return true;
+        case TOKEN_PAGKAKAKILANLAN: {
+            Konstant* konstant = resolveKonstant(token);
+            if (konstant == NULL || IS_NULL(konstant->value)) return false;
+            *value = konstant->value;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
 
-    consume(TOKEN_KALIWANG_BRACE, 
-        "Inaasahan na makakita ng '{' bago ang 'kapag'.");
+// Looks ahead through the body of the 'suriin' without compiling it. The
+// cases can only be dispatched through a table when every 'kapag' label
+// is a single literal or 'konst', otherwise they are compared one by one.
+static SwitchKind switchKind(double* min, double* max) {
+    Scanner scannerState = saveScanner();
+    Token token = parser.current;
+    int depth = 0;
+    int caseCount = 0;
+    bool allLiterals = true;
+    bool allIntegers = true;
+
+    while (allLiterals && token.type != TOKEN_DULO) {
+        if (token.type == TOKEN_KALIWANG_BRACE) {
+            depth++;
+        } else if (token.type == TOKEN_KANANG_BRACE) {
+            if (depth-- == 0) break;
+        } else if (token.type == TOKEN_KAPAG && depth == 0) {
+            Token label = scanToken();
+            bool isNegative = label.type == TOKEN_BAWAS;
+            if (isNegative) label = scanToken();
+
+            Value labelValue;
+            if (scanToken().type != TOKEN_TUTULDOK ||
+                !literalValue(&label, &labelValue)) {
+                allLiterals = false;
+            } else if (IS_NUMBER(labelValue)) {
+                double value = AS_NUMBER(labelValue);
+                if (isNegative) value = -value;
+
+                if (value < INT32_MIN || value > INT32_MAX ||
+                    value != (int)value) {
+                    allIntegers = false;
+                } else if (caseCount == 0) {
+                    *min = *max = value;
+                } else {
+                    if (value < *min) *min = value;
+                    if (value > *max) *max = value;
+                }
+            } else if (!isNegative) {
+                allIntegers = false;
+            } else {
+                allLiterals = false;
+            }
+
+            caseCount++;
+        }
+
+        token = scanToken();
+    }
+
+    restoreScanner(scannerState);
+
+    if (!allLiterals || caseCount < SWITCH_TABLE_MIN_CASES) {
+        return SWITCH_CHAIN;
+    }
+
+    // At least half of the slots should be used to be worth a direct table.
+    if (allIntegers && *max - *min < (double)caseCount * 2) {
+        return SWITCH_DENSE;
+    }
+
+    return SWITCH_HASH;
+}
+
+static Value caseLabel() {
+    bool isNegative = match(TOKEN_BAWAS);
+    advance();
+
+    Value value;
+    if (!literalValue(&parser.previous, &value)) {
+        error("Inasahan na makakita ng ekspresyon.");
+        return NULL_VAL;
+    }
+
+    if (isNegative && IS_NUMBER(value)) value = NUMBER_VAL(-AS_NUMBER(value));
+    return value;
+}
+
+static void addCase(int tableIndex, Value label, int offset) {
+    SwitchTable* table = &currentChunk()->switches[tableIndex];
+
+    // The first matching 'kapag' wins just like in the comparison chain.
+    if (table->offsets != NULL) {
+        int slot = (int)(AS_NUMBER(label) - table->min);
+        if (table->offsets[slot] == -1) table->offsets[slot] = offset;
+        return;
+    }
+
+    Value existing;
+    if (valueTableGet(&table->cases, label, &existing)) return;
+
+    push(label);
+    valueTableSet(&table->cases, label, NUMBER_VAL(offset));
+    pop();
+}
+
+static void addCaseEnd(int** caseEnds, int* count, int* capacity) {
+    if (*capacity < *count + 1) {
+        int oldCapacity = *capacity;
+        *capacity = GROW_CAPACITY(oldCapacity);
+        *caseEnds = GROW_ARRAY(int, *caseEnds, oldCapacity, *capacity);
+    }
+
+    (*caseEnds)[(*count)++] = emitJump(OP_JUMP);
+}
+
+static void tableSwitch(SwitchKind kind, double min, double max) {
+    int tableIndex = addSwitchTable(currentChunk());
+    if (kind == SWITCH_DENSE) {
+        int count = (int)(max - min) + 1;
+        int* offsets = ALLOCATE(int, count);
+        for (int i = 0; i < count; i++) offsets[i] = -1;
+
+        SwitchTable* table = &currentChunk()->switches[tableIndex];
+        table->min = min;
+        table->offsetCount = count;
+        table->offsets = offsets;
+    }
+
+    emitOperand(OP_SWITCH, tableIndex);
+
+    int state = 0; // 0: before all cases (kapag), 1: before default (palya), 2: after default (palya).
+    int* caseEnds = NULL;
+    int caseCount = 0;
+    int caseCapacity = 0;
+
+    while (!match(TOKEN_KANANG_BRACE) && !check(TOKEN_DULO)) {
+        if (match(TOKEN_KAPAG) || match(TOKEN_PALYA)) {
+            TokenType caseType = parser.previous.type;
+
+            if (state == 2) {
+                error("Hindi na maaaring magdagdag pa ng 'kapag' o isa pang 'palya' matapos ang naunang 'palya'.");
+            }
+
+            if (state != 0) {
+                // At the end of the previous case jump over the others.
+                endScope();
+                addCaseEnd(&caseEnds, &caseCount, &caseCapacity);
+            }
+
+            beginScope();
+            if (caseType == TOKEN_KAPAG) {
+                state = 1;
+                Value label = caseLabel();
+                consume(TOKEN_TUTULDOK, "Inaasahan na makakita ng ':' matapos ang halaga sa 'kapag'.");
+                addCase(tableIndex, label, currentChunk()->count);
+            } else {
+                if (state == 0) {
+                    error("Inaasahan na makakita ng kahit isang 'kapag' bago ang 'palya'.");
+                }
+
+                state = 2;
+                consume(TOKEN_TUTULDOK, "Inaasahan na makakita ng ':' matapos ang halaga sa 'palya'.");
+                currentChunk()->switches[tableIndex].defaultOffset =
+                    currentChunk()->count;
+            }
+        } else {
+            // Otherwise, it's a statement inside the current case.
+            if (state == 0) {
+                error("Hindi maaari ang mga pahayag bago ang 'kapag'.");
+            }
+            statement();
+        }
+    }
+
+    // The last case simply falls through to the end.
+    if (state != 0) endScope();
 
-    int surroundingLoopExitCount = innermostLoopExitCount == -1 ?
-                                     0 : innermostLoopExitCount;
-    innermostLoopExitCount = 0;
+    // Patch all the case jumps to the end.
+    for (int i = 0; i < caseCount; i++) {
+        patchJump(caseEnds[i]);
+    }
+    FREE_ARRAY(int, caseEnds, caseCapacity);
+
+    // Values without a 'kapag' go to 'palya' or straight to the end.
+    SwitchTable* table = &currentChunk()->switches[tableIndex];
+    if (table->defaultOffset == -1) {
+        table->defaultOffset = currentChunk()->count;
+    }
+
+    for (int i = 0; i < table->offsetCount; i++) {
+        if (table->offsets[i] == -1) table->offsets[i] = table->defaultOffset;
+    }
+}
 
+static void chainSwitch() {
     int state = 0; // 0: before all cases (kapag), 1: before default (palya), 2: after default (palya).
-    int caseEnds[MAX_CASES];
+    int* caseEnds = NULL;
     int caseCount = 0;
+    int caseCapacity = 0;
     int previousCaseSkip = -1;
-    
+
     while (!match(TOKEN_KANANG_BRACE) && !check(TOKEN_DULO)) {
         if (match(TOKEN_KAPAG) || match(TOKEN_PALYA)) {
             TokenType caseType = parser.previous.type;
@@ -1122,7 +3115,7 @@ static void switchStatement() {
                 // - end its scope.
                 endScope();
                 // - jump over the others.
-                caseEnds[caseCount++] = emitJump(OP_JUMP);
+                addCaseEnd(&caseEnds, &caseCount, &caseCapacity);
 
                 // Patch its condition to jump to the next case (this one).
                 patchJump(previousCaseSkip);
@@ -1163,22 +3156,16 @@ static void switchStatement() {
         }
     }
 
-    for (int i = surroundingLoopExitCount; 
-         i < innermostLoopExitCount + surroundingLoopExitCount; 
-         i++) {
-        patchJump(innermostLoopExits[i]);
-    }
-
     // If we ended without a default case, patch its condition jump.
     if (state == 1) {
         endScope();
-        caseEnds[caseCount++] = emitJump(OP_JUMP);
+        addCaseEnd(&caseEnds, &caseCount, &caseCapacity);
 
         patchJump(previousCaseSkip);
         emitByte(OP_POP);
     }
 
-    // If we ended without any case, report an error. 
+    // If we ended without any case, report an error.
     // default-only situation was handled inside the loop.
     if (state == 2 && caseCount == 0) {
         error("Inaasahan na makakita ng kahit isang 'kapag' sa loob ng 'suriin' na pahayag.");
@@ -1188,12 +3175,42 @@ static void switchStatement() {
     for (int i = 0; i < caseCount; i++) {
         patchJump(caseEnds[i]);
     }
+    FREE_ARRAY(int, caseEnds, caseCapacity);
+}
+
+static void switchStatement() {
+    // The switch value stays on the stack as a hidden local in its own
+    // scope, so 'ituloy' and 'itigil' know when to discard it.
+    beginScope();
+
+    consume(TOKEN_KALIWANG_PAREN,
+        "Inasahan na makakita ng '(' matapos ang 'suriin'.");
+    expression();
+    addLocal(syntheticToken(""));
+    markInitialized();
+    consume(TOKEN_KANANG_PAREN,
+        "Inasahan na makakita ng ')' matapos ang ekspresyon.");
+
+    consume(TOKEN_KALIWANG_BRACE,
+        "Inaasahan na makakita ng '{' bago ang 'kapag'.");
+
+    int surroundingLoopExitCount = innermostLoopExitCount;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostExitDepth = current->scopeDepth;
+
+    double min = 0;
+    double max = 0;
+    SwitchKind kind = switchKind(&min, &max);
+    if (kind == SWITCH_CHAIN) {
+        chainSwitch();
+    } else {
+        tableSwitch(kind, min, max);
+    }
 
-    // ExitCount also acts as state so 0 count should be -1.
-    innermostLoopExitCount = surroundingLoopExitCount == 0 ?
-                               -1 : surroundingLoopExitCount;
+    patchExits(surroundingLoopExitCount);
+    innermostExitDepth = surroundingExitDepth;
 
-    emitByte(OP_POP); // The switch value.
+    endScope(); // The switch value.
 }
 
 static void printStatement() {
@@ -1222,12 +3239,14 @@ static void returnStatement() {
     }
 }
 
-static void discardInnerLocals() {
-    // Discard any locals created inside the loop.
+static void discardInnerLocals(int depth) {
+    // Discard any locals created inside the loop. Whether a local is
+    // captured is only known once the whole body is compiled, so they are
+    // all closed in case a closure refers to them.
     for (int i = current->localCount -1;
-         i >= 0 && current->locals[i].depth > innermostLoopDepth;
+         i >= 0 && current->locals[i].depth > depth;
          i--) {
-        emitByte(OP_POP);
+        emitByte(OP_CLOSE_UPVALUE);
     }
 }
 
@@ -1239,31 +3258,36 @@ static void continueStatement() {
     consume(TOKEN_TULDOK_KUWIT, 
         "Inasahan na makakita ng ';' matapos ang nilalaman.");
 
-    discardInnerLocals();
+    discardInnerLocals(innermostLoopDepth);
 
     // Jump to top of current innermost loop.
     emitLoop(innermostLoopStart);
 }
 
 static void breakStatement() {
-    if (innermostLoopExitCount == -1) {
+    if (innermostExitDepth == -1) {
         error("Hindi maaaring gamitin ang 'itigil' sa labas ng loop o labas ng 'suriin' na pahayag.");
     }
 
     consume(TOKEN_TULDOK_KUWIT, 
         "Inasahan na makakita ng ';' matapos ang nilalaman.");
          
-    discardInnerLocals();
+    discardInnerLocals(innermostExitDepth);
+
+    if (innermostLoopExitCount == MAX_BREAKS) {
+        error("Masyadong maraming 'itigil' sa loob ng loop o 'suriin' na pahayag.");
+        return;
+    }
 
     // Jump unconditionally outside the loop or switch.
     // To be patched once all statements have been compiled.
     innermostLoopExits[innermostLoopExitCount++] = emitJump(OP_JUMP);
 }
 
-static void whileStatement() {
-    int surroundingLoopExitCount = innermostLoopExitCount == -1 ?
-                                     0 : innermostLoopExitCount;
-    innermostLoopExitCount = 0;
+static void whileLoop() {
+    int surroundingLoopExitCount = innermostLoopExitCount;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostExitDepth = current->scopeDepth;
 
     int surroundingLoopStart = innermostLoopStart;
     int surroundingLoopScopeDepth = innermostLoopDepth;
@@ -1284,23 +3308,20 @@ static void whileStatement() {
     patchJump(exitJump);
     emitByte(OP_POP);
 
-    for (int i = surroundingLoopExitCount;
-         i < innermostLoopExitCount + surroundingLoopExitCount; 
-         i++) {
-        patchJump(innermostLoopExits[i]);
-    }
-
-    // ExitCount also acts as state so 0 count should be -1.
-    innermostLoopExitCount = surroundingLoopExitCount == 0 ?
-                               -1 : surroundingLoopExitCount;
+    patchExits(surroundingLoopExitCount);
+    innermostExitDepth = surroundingExitDepth;
     innermostLoopStart = surroundingLoopStart;
     innermostLoopDepth = surroundingLoopScopeDepth;
 }
 
+static void whileStatement() {
+    guardedLoop(TOKEN_HABANG, -1, syntheticToken(""));
+}
+
 static void doWhileStatement() {
-    int surroundingLoopExitCount = innermostLoopExitCount == -1 ?
-                                     0 : innermostLoopExitCount;
-    innermostLoopExitCount = 0;
+    int surroundingLoopExitCount = innermostLoopExitCount;
+    int surroundingExitDepth = innermostExitDepth;
+    innermostExitDepth = current->scopeDepth;
 
     int surroundingLoopStart = innermostLoopStart;
     int surroundingLoopScopeDepth = innermostLoopDepth;
@@ -1326,15 +3347,8 @@ static void doWhileStatement() {
     patchJump(exitJump);
     emitByte(OP_POP);
 
-    for (int i = surroundingLoopExitCount;
-         i < innermostLoopExitCount + surroundingLoopExitCount; 
-         i++) {
-        patchJump(innermostLoopExits[i]);
-    }
-
-    // ExitCount also acts as state so 0 count should be -1.
-    innermostLoopExitCount = surroundingLoopExitCount == 0 ?
-                               -1 : surroundingLoopExitCount;
+    patchExits(surroundingLoopExitCount);
+    innermostExitDepth = surroundingExitDepth;
     innermostLoopStart = surroundingLoopStart;
     innermostLoopDepth = surroundingLoopScopeDepth;
 }
@@ -1348,6 +3362,7 @@ static void synchronize() {
             case TOKEN_URI:
             case TOKEN_GAWAIN:
             case TOKEN_KILALANIN:
+            case TOKEN_KONST:
             case TOKEN_KADA:
             case TOKEN_KUNG:
             case TOKEN_GAWIN:
@@ -1364,6 +3379,58 @@ static void synchronize() {
     }
 }
 
+// Whether the name is a global declared earlier in the script, or one that
+// already exists like a native or one from a previous line in the REPL.
+static bool isGlobalDeclared(Token* name) {
+    for (int i = 0; i < globalNameCount; i++) {
+        if (identifiersEqual(name, &globalNames[i])) return true;
+    }
+
+    Value value;
+    ObjString* string = copyString(name->start, name->length);
+    return tableGet(&vm.globals, string, &value);
+}
+
+static void konstDeclaration() {
+    if (current->type != TYPE_SCRIPT || current->scopeDepth > 0) {
+        error("Maaari lamang gamitin ang 'konst' sa pinakalabas na bahagi ng skrip.");
+    }
+
+    consume(TOKEN_PAGKAKAKILANLAN, "Inasahan ang pangalan ng konst.");
+    Token name = parser.previous;
+    if (findKonstant(&name) != NULL) {
+        error("Mayroon ng konst na may ganitong pangalan.");
+    } else if (isGlobalDeclared(&name)) {
+        error("Mayroon ng lagayan na may ganitong pangalan.");
+    }
+
+    consume(TOKEN_KATUMBAS, "Inasahan na makakita ng '=' matapos ang pangalan ng konst.");
+
+    // Compiled like any expression, which has to fold into one constant.
+    int start = currentChunk()->count;
+    expression();
+    Value value;
+    int valueStart;
+    if (!lastConstant(&value, &valueStart) || valueStart != start) {
+        error("Ang halaga ng konst ay dapat malaman bago paandarin ang skrip.");
+    }
+    rewindChunk(start);
+
+    consume(TOKEN_TULDOK_KUWIT,
+            "Inasahan na makakita ng ';' matapos ideklara ang konst.");
+
+    if (konstantCapacity < konstantCount + 1) {
+        int oldCapacity = konstantCapacity;
+        konstantCapacity = GROW_CAPACITY(oldCapacity);
+        konstants = GROW_ARRAY(Konstant, konstants, oldCapacity,
+                               konstantCapacity);
+    }
+
+    konstants[konstantCount].name = name;
+    konstants[konstantCount].value = value;
+    konstantCount++;
+}
+
 static void declaration() {
     if (match(TOKEN_URI)) {
         classDeclaration();
@@ -1371,6 +3438,8 @@ static void declaration() {
         funDeclaration();
     } else if (match(TOKEN_KILALANIN)) {
         varDeclaration();
+    } else if (match(TOKEN_KONST)) {
+        konstDeclaration();
     } else {
         statement();
     }
@@ -1406,10 +3475,188 @@ static void statement() {
     }
 }
 
-ObjFunction* compile(const char* source) {
+static void scanInlineFunction() {
+    InlineFunction function;
+    function.name = scanToken();
+    function.arity = 0;
+    function.isExpression = false;
+    function.hasCall = false;
+    function.hasAssignment = false;
+    function.isDeclared = false;
+    function.isReassigned = false;
+
+    if (function.name.type != TOKEN_PAGKAKAKILANLAN ||
+        scanToken().type != TOKEN_KALIWANG_PAREN) {
+        return;
+    }
+
+    Token token = scanToken();
+    if (token.type != TOKEN_KANANG_PAREN) {
+        for (;;) {
+            if (token.type != TOKEN_PAGKAKAKILANLAN ||
+                function.arity == MAX_INLINE_PARAMS) {
+                return;
+            }
+
+            function.params[function.arity++] = token;
+            token = scanToken();
+            if (token.type == TOKEN_KANANG_PAREN) break;
+            if (token.type != TOKEN_KUWIT) return;
+            token = scanToken();
+        }
+    }
+
+    if (scanToken().type != TOKEN_KALIWANG_BRACE) return;
+    function.body = saveScanner();
+
+    // Always read up to the closing '}' so the caller keeps its depth.
+    int depth = 0;
+    int tokenCount = 0;
+    int statementCount = 0;
+    bool isInlinable = true;
+    TokenType previous = TOKEN_KALIWANG_BRACE;
+
+    for (token = scanToken(); token.type != TOKEN_KANANG_BRACE || depth > 0;
+         token = scanToken()) {
+        if (token.type == TOKEN_DULO) return;
+        tokenCount++;
+
+        switch (token.type) {
+            case TOKEN_KALIWANG_BRACE: depth++; break;
+            case TOKEN_KANANG_BRACE: depth--; break;
+            case TOKEN_GAWAIN:
+            case TOKEN_URI:
+            case TOKEN_ITO:
+            case TOKEN_MULA:
+            case TOKEN_PROBLEMA:
+                isInlinable = false;
+                break;
+            case TOKEN_IBALIK:
+                if (tokenCount == 1) {
+                    function.isExpression = true;
+                } else {
+                    isInlinable = false;
+                }
+                break;
+            case TOKEN_KATUMBAS:
+            case TOKEN_DAGDAG_KATUMBAS:
+            case TOKEN_BAWAS_KATUMBAS:
+            case TOKEN_BITUIN_KATUMBAS:
+            case TOKEN_SULONG_PAHILIS_KATUMBAS:
+            case TOKEN_DAGDAG_ISA:
+            case TOKEN_BAWAS_ISA:
+                function.hasAssignment = true;
+                break;
+            case TOKEN_KALIWANG_PAREN:
+                if (previous == TOKEN_PAGKAKAKILANLAN ||
+                    previous == TOKEN_KANANG_PAREN ||
+                    previous == TOKEN_KANANG_BRACKET) {
+                    function.hasCall = true;
+                }
+                break;
+            case TOKEN_TULDOK_KUWIT:
+                if (depth == 0) statementCount++;
+                break;
+            case TOKEN_PAGKAKAKILANLAN:
+                if (identifiersEqual(&token, &function.name)) {
+                    isInlinable = false;
+                }
+                break;
+            default:
+                break;
+        }
+
+        previous = token.type;
+    }
+
+    // An 'ibalik' body must be exactly one statement with an expression.
+    if (function.isExpression && (statementCount != 1 ||
+        previous != TOKEN_TULDOK_KUWIT || tokenCount < 3)) {
+        isInlinable = false;
+    }
+
+    if (!isInlinable || tokenCount > INLINE_MAX_TOKENS) return;
+
+    if (inlineFunctionCapacity < inlineFunctionCount + 1) {
+        int oldCapacity = inlineFunctionCapacity;
+        inlineFunctionCapacity = GROW_CAPACITY(oldCapacity);
+        inlineFunctions = GROW_ARRAY(InlineFunction, inlineFunctions,
+            oldCapacity, inlineFunctionCapacity);
+    }
+
+    inlineFunctions[inlineFunctionCount++] = function;
+}
+
+// Reads the whole source once before compiling it to find the top-level
+// functions that can be inlined, then drops the ones that are assigned to
+// or declared again anywhere.
+static void findInlineFunctions() {
+    inlineFunctionCount = 0;
+    Scanner scannerState = saveScanner();
+
+    int depth = 0;
+    for (Token token = scanToken(); token.type != TOKEN_DULO;
+         token = scanToken()) {
+        if (token.type == TOKEN_KALIWANG_BRACE) {
+            depth++;
+        } else if (token.type == TOKEN_KANANG_BRACE) {
+            depth--;
+        } else if (token.type == TOKEN_GAWAIN && depth == 0) {
+            scanInlineFunction();
+        }
+    }
+
+    restoreScanner(scannerState);
+    if (inlineFunctionCount == 0) return;
+
+    depth = 0;
+    TokenType before = TOKEN_TULDOK_KUWIT;
+    Token token = scanToken();
+    while (token.type != TOKEN_DULO) {
+        Token after = scanToken();
+
+        if (token.type == TOKEN_KALIWANG_BRACE) {
+            depth++;
+        } else if (token.type == TOKEN_KANANG_BRACE) {
+            depth--;
+        } else if (token.type == TOKEN_PAGKAKAKILANLAN &&
+                   before != TOKEN_TULDOK) {
+            InlineFunction* function = findInlineFunction(&token);
+            bool isDeclaration = before == TOKEN_GAWAIN ||
+                                 before == TOKEN_KILALANIN ||
+                                 before == TOKEN_URI;
+
+            if (function != NULL &&
+                ((isDeclaration && depth == 0 &&
+                  token.start != function->name.start) ||
+                 after.type == TOKEN_KATUMBAS ||
+                 after.type == TOKEN_DAGDAG_KATUMBAS ||
+                 after.type == TOKEN_BAWAS_KATUMBAS ||
+                 after.type == TOKEN_BITUIN_KATUMBAS ||
+                 after.type == TOKEN_SULONG_PAHILIS_KATUMBAS ||
+                 after.type == TOKEN_DAGDAG_ISA ||
+                 after.type == TOKEN_BAWAS_ISA ||
+                 before == TOKEN_DAGDAG_ISA ||
+                 before == TOKEN_BAWAS_ISA)) {
+                function->isReassigned = true;
+            }
+        }
+
+        before = token.type;
+        token = after;
+    }
+
+    restoreScanner(scannerState);
+}
+
+static ObjFunction* script(Compiler* compiler, const char* source,
+                           bool longJumps) {
     initScanner(source);
-    Compiler compiler;
-    initCompiler(&compiler, TYPE_SCRIPT);
+    scriptSource = source;
+    initCompiler(compiler, TYPE_SCRIPT, longJumps);
+    findInlineFunctions();
+    konstantCount = 0;
+    globalNameCount = 0;
 
     parser.hadError = false;
     parser.panicMode = false;
@@ -1420,14 +3667,83 @@ ObjFunction* compile(const char* source) {
         declaration();
     }
 
-    ObjFunction* function = endCompiler();
+    return endCompiler();
+}
+
+ObjFunction* compile(const char* source, bool compileLazily) {
+    lazyBodies = compileLazily;
+    Compiler compiler;
+    ObjFunction* function = script(&compiler, source, false);
+    if (compiler.jumpOverflow && !parser.hadError) {
+        freeCompiler(&compiler);
+        function = script(&compiler, source, true);
+    }
+
+    freeCompiler(&compiler);
+    scriptSource = NULL;
+    FREE_ARRAY(InlineFunction, inlineFunctions, inlineFunctionCapacity);
+    inlineFunctions = NULL;
+    inlineFunctionCount = 0;
+    inlineFunctionCapacity = 0;
+    FREE_ARRAY(Konstant, konstants, konstantCapacity);
+    konstants = NULL;
+    konstantCount = 0;
+    konstantCapacity = 0;
+    FREE_ARRAY(Token, globalNames, globalNameCapacity);
+    globalNames = NULL;
+    globalNameCount = 0;
+    globalNameCapacity = 0;
+    if (hasWrittenNames) {
+        freeTable(&writtenNames);
+        hasWrittenNames = false;
+    }
     return parser.hadError ? NULL : function;
 }
 
+bool compileFunction(ObjFunction* function) {
+    initScanner(function->source->chars);
+    Scanner scannerState = saveScanner();
+    scannerState.line = function->line;
+    restoreScanner(scannerState);
+
+    parser.hadError = false;
+    parser.panicMode = false;
+    parser.previous.start = function->name->chars;
+    parser.previous.length = function->name->length;
+    advance();
+
+    lazyCompiled = function;
+    scannerState = saveScanner();
+    Parser parserState = parser;
+
+    Compiler compiler;
+    ObjFunction* compiled = functionBody(&compiler, TYPE_FUNCTION, false);
+    if (compiler.jumpOverflow && !parser.hadError) {
+        freeCompiler(&compiler);
+        restoreScanner(scannerState);
+        parser = parserState;
+        compiled = functionBody(&compiler, TYPE_FUNCTION, true);
+    }
+
+    freeCompiler(&compiler);
+    lazyCompiled = NULL;
+    if (parser.hadError) return false;
+
+    // The closures already point at this function, so it takes the code.
+    function->chunk = compiled->chunk;
+    function->slotCount = compiled->slotCount;
+    initChunk(&compiled->chunk);
+    function->source = NULL;
+    freeValueArray(&function->upvalueNames);
+    return true;
+}
+
 void markCompilerRoots() {
     Compiler* compiler = current;
     while (compiler != NULL) {
         markObject((Obj*)compiler->function);
         compiler = compiler->enclosing;
     }
+
+    if (hasWrittenNames) markTable(&writtenNames);
 }
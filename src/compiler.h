@@ -4,7 +4,8 @@
 #include "object.h"
 #include "vm.h"
 
-ObjFunction* compile(const char* source);
+ObjFunction* compile(const char* source, bool compileLazily);
+bool compileFunction(ObjFunction* function);
 void markCompilerRoots();
 
 #endif
@@ -3,8 +3,12 @@
 #include "debug.h"
 #include "object.h"
 #include "value.h"
+#include "vm.h"
 
 void disassembleChunk(Chunk* chunk, const char* name) {
+    // Values go through the buffer of 'ipakita', so it is written out
+    // first to keep everything in order.
+    flushOutput();
     printf("== %s ==\n", name);
 
     for (int offset = 0; offset < chunk->count;) {
@@ -12,23 +16,12 @@ void disassembleChunk(Chunk* chunk, const char* name) {
     }
 }
 
-static int elementInstruction(const char* name, Chunk* chunk,
-                                int offset, int indexOffset) {
-    uint8_t index = chunk->code[offset - 1];
-    uint8_t constant = index - 1;
-    printf("%-16s %4d[%d] '", name, constant - indexOffset, index - indexOffset);
-    printValue(chunk->constants.values[constant - indexOffset]);
-    printf("[");
-    printValue(chunk->constants.values[index - indexOffset]);
-    printf("]'\n");
-    return offset + 1;
-}
-
 static int constantInstruction(const char* name, Chunk* chunk, 
                                 int offset) {
     uint8_t constant = chunk->code[offset + 1];
     printf("%-16s %4d '", name, constant);
     printValue(chunk->constants.values[constant]);
+    flushOutput();
     printf("'\n");
     return offset + 2;
 }
@@ -40,6 +33,7 @@ static int longConstantInstruction(const char* name, Chunk* chunk,
                         chunk->code[offset + 3];
     printf("%-16s %4d '", name, constant);
     printValue(chunk->constants.values[constant]);
+    flushOutput();
     printf("'\n");
     return offset + 4;
 }
@@ -49,15 +43,41 @@ static int invokeInstruction(const char* name, Chunk* chunk, int offset) {
     uint8_t argCount = chunk->code[offset + 2];
     printf("%-16s (%d args) %4d '", name, argCount, constant);
     printValue(chunk->constants.values[constant]);
+    flushOutput();
     printf("'\n");
     return offset + 3;
 }
 
+static int longInvokeInstruction(const char* name, Chunk* chunk,
+                                 int offset) {
+    uint32_t constant = (chunk->code[offset + 1] << 16) |
+                        (chunk->code[offset + 2] << 8) |
+                        chunk->code[offset + 3];
+    uint8_t argCount = chunk->code[offset + 4];
+    printf("%-16s (%d args) %4d '", name, argCount, constant);
+    printValue(chunk->constants.values[constant]);
+    flushOutput();
+    printf("'\n");
+    return offset + 5;
+}
+
 static int simpleInstruction(const char* name, int offset) {
     printf("%s\n", name);
     return offset + 1;
 }
 
+// Arithmetic and comparison instructions can be quickened at runtime, so
+// also show how often each one fell back from its specialized form.
+static int quickenedInstruction(const char* name, Chunk* chunk,
+                                int offset) {
+    if (chunk->fallbacks != NULL && chunk->fallbacks[offset] > 0) {
+        printf("%-16s (%d fallback)\n", name, chunk->fallbacks[offset]);
+    } else {
+        printf("%s\n", name);
+    }
+    return offset + 1;
+}
+
 static int byteInstruction(const char* name, Chunk* chunk,
                             int offset) {
     uint8_t slot = chunk->code[offset + 1];
@@ -65,6 +85,23 @@ static int byteInstruction(const char* name, Chunk* chunk,
     return offset + 2;
 }
 
+static int longByteInstruction(const char* name, Chunk* chunk,
+                               int offset) {
+    uint32_t slot = (chunk->code[offset + 1] << 16) |
+                    (chunk->code[offset + 2] << 8) |
+                    chunk->code[offset + 3];
+    printf("%-16s %4d\n", name, slot);
+    return offset + 4;
+}
+
+static int immediateInstruction(const char* name, Chunk* chunk,
+                                int offset) {
+    int16_t value = (int16_t)((chunk->code[offset + 1] << 8) |
+                              chunk->code[offset + 2]);
+    printf("%-16s %4d\n", name, value);
+    return offset + 3;
+}
+
 static int jumpInstruction(const char* name, int sign,
                             Chunk* chunk, int offset) {
     uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
@@ -74,6 +111,99 @@ static int jumpInstruction(const char* name, int sign,
     return offset + 3;
 }
 
+static int longJumpInstruction(const char* name, int sign,
+                               Chunk* chunk, int offset) {
+    uint32_t jump = (chunk->code[offset + 1] << 16) |
+                    (chunk->code[offset + 2] << 8) |
+                    chunk->code[offset + 3];
+    printf("%-16s %4d -> %d\n", name, offset,
+            offset + 4 + sign * (int)jump);
+    return offset + 4;
+}
+
+static const char* operationName(uint8_t operation) {
+    switch (operation) {
+        case OP_ADD:      return "+=";
+        case OP_SUBTRACT: return "-=";
+        case OP_MULTIPLY: return "*=";
+        case OP_DIVIDE:   return "/=";
+        default:          return "?=";
+    }
+}
+
+static int modifyInstruction(const char* name, bool isLong, bool isName,
+                             Chunk* chunk, int offset) {
+    uint32_t operand = chunk->code[offset + 1];
+    int length = 3;
+    if (isLong) {
+        operand = (operand << 16) | (chunk->code[offset + 2] << 8) |
+                  chunk->code[offset + 3];
+        length = 5;
+    }
+
+    printf("%-16s %4d ", name, operand);
+    if (isName) {
+        printf("'");
+        printValue(chunk->constants.values[operand]);
+        flushOutput();
+        printf("' ");
+    }
+    printf("%s\n", operationName(chunk->code[offset + length - 1]));
+    return offset + length;
+}
+
+static int switchInstruction(const char* name, bool isLong,
+                             Chunk* chunk, int offset) {
+    uint32_t index = chunk->code[offset + 1];
+    int length = 2;
+    if (isLong) {
+        index = (index << 16) | (chunk->code[offset + 2] << 8) |
+                chunk->code[offset + 3];
+        length = 4;
+    }
+
+    SwitchTable* table = &chunk->switches[index];
+    int caseCount = table->offsets != NULL ?
+        table->offsetCount : table->cases.count;
+    printf("%-16s %4d %s %d cases, default -> %d\n", name, index,
+           table->offsets != NULL ? "dense" : "hash", caseCount,
+           table->defaultOffset);
+    return offset + length;
+}
+
+static int closureInstruction(const char* name, bool isLong,
+                              Chunk* chunk, int offset) {
+    offset++;
+    uint32_t constant = chunk->code[offset++];
+    if (isLong) {
+        constant = (constant << 16) | (chunk->code[offset] << 8) |
+                   chunk->code[offset + 1];
+        offset += 2;
+    }
+    printf("%-16s %4d ", name, constant);
+    printValue(chunk->constants.values[constant]);
+    flushOutput();
+    printf("\n");
+
+    ObjFunction* function = AS_FUNCTION(
+        chunk->constants.values[constant]);
+    for (int j = 0; j < function->upvalueCount; j++) {
+        int start = offset;
+        int flags = chunk->code[offset++];
+        int index = chunk->code[offset++];
+        if (isLong) {
+            index = (index << 16) | (chunk->code[offset] << 8) |
+                    chunk->code[offset + 1];
+            offset += 2;
+        }
+        printf("%04d      |                     %s %d%s\n", start,
+               (flags & UPVALUE_LOCAL) ? "local" : "upvalue", index,
+               (flags & UPVALUE_VALUE) ? " value" : "");
+    }
+
+    return offset;
+}
+
 int disassembleInstruction(Chunk* chunk, int offset) {
     printf("%04d ", offset);
     int line = getLine(chunk, offset);
@@ -89,6 +219,8 @@ int disassembleInstruction(Chunk* chunk, int offset) {
             return constantInstruction("OP_CONSTANT", chunk, offset);
         case OP_LONG_CONSTANT:
             return longConstantInstruction("OP_LONG_CONSTANT", chunk, offset);
+        case OP_PUSH_SMALL_INT:
+            return immediateInstruction("OP_PUSH_SMALL_INT", chunk, offset);
         case OP_NULL:
             return simpleInstruction("OP_NULL", offset);
         case OP_TRUE:
@@ -101,98 +233,249 @@ int disassembleInstruction(Chunk* chunk, int offset) {
             return simpleInstruction("OP_DUP", offset);
         case OP_GET_LOCAL:
             return byteInstruction("OP_GET_LOCAL", chunk, offset);
+        case OP_LONG_GET_LOCAL:
+            return longByteInstruction("OP_LONG_GET_LOCAL", chunk, offset);
         case OP_SET_LOCAL:
             return byteInstruction("OP_SET_LOCAL", chunk, offset);
+        case OP_LONG_SET_LOCAL:
+            return longByteInstruction("OP_LONG_SET_LOCAL", chunk, offset);
+        case OP_INC_LOCAL:
+            return byteInstruction("OP_INC_LOCAL", chunk, offset);
+        case OP_LONG_INC_LOCAL:
+            return longByteInstruction("OP_LONG_INC_LOCAL", chunk, offset);
+        case OP_DEC_LOCAL:
+            return byteInstruction("OP_DEC_LOCAL", chunk, offset);
+        case OP_LONG_DEC_LOCAL:
+            return longByteInstruction("OP_LONG_DEC_LOCAL", chunk, offset);
+        case OP_MODIFY_LOCAL:
+            return modifyInstruction("OP_MODIFY_LOCAL", false,
+                                     false, chunk, offset);
+        case OP_LONG_MODIFY_LOCAL:
+            return modifyInstruction("OP_LONG_MODIFY_LOCAL", true,
+                                     false, chunk, offset);
         case OP_GET_GLOBAL:
             return constantInstruction("OP_GET_GLOBAL", chunk, offset);
+        case OP_LONG_GET_GLOBAL:
+            return longConstantInstruction("OP_LONG_GET_GLOBAL", chunk, offset);
         case OP_DEFINE_GLOBAL:
             return constantInstruction("OP_DEFINE_GLOBAL", chunk, offset);
+        case OP_LONG_DEFINE_GLOBAL:
+            return longConstantInstruction("OP_LONG_DEFINE_GLOBAL", chunk, offset);
         case OP_SET_GLOBAL:
             return constantInstruction("OP_SET_GLOBAL", chunk, offset);
+        case OP_LONG_SET_GLOBAL:
+            return longConstantInstruction("OP_LONG_SET_GLOBAL", chunk, offset);
+        case OP_INC_GLOBAL:
+            return constantInstruction("OP_INC_GLOBAL", chunk, offset);
+        case OP_LONG_INC_GLOBAL:
+            return longConstantInstruction("OP_LONG_INC_GLOBAL", chunk, offset);
+        case OP_DEC_GLOBAL:
+            return constantInstruction("OP_DEC_GLOBAL", chunk, offset);
+        case OP_LONG_DEC_GLOBAL:
+            return longConstantInstruction("OP_LONG_DEC_GLOBAL", chunk, offset);
+        case OP_MODIFY_GLOBAL:
+            return modifyInstruction("OP_MODIFY_GLOBAL", false,
+                                     true, chunk, offset);
+        case OP_LONG_MODIFY_GLOBAL:
+            return modifyInstruction("OP_LONG_MODIFY_GLOBAL", true,
+                                     true, chunk, offset);
+        case OP_DEFINED:
+            return constantInstruction("OP_DEFINED", chunk, offset);
+        case OP_LONG_DEFINED:
+            return longConstantInstruction("OP_LONG_DEFINED", chunk, offset);
         case OP_GET_ELEMENT:
-            return elementInstruction("OP_GET_ELEMENT", chunk, offset, 0);
+            return simpleInstruction("OP_GET_ELEMENT", offset);
+        case OP_GET_ELEMENT_UNCHECKED:
+            return simpleInstruction("OP_GET_ELEMENT_UNCHECKED", offset);
+        case OP_GET_ELEMENT_2D:
+            return simpleInstruction("OP_GET_ELEMENT_2D", offset);
         case OP_DEFINE_ARRAY:
-            return simpleInstruction("OP_DEFINE_ARRAY", offset);
+            return byteInstruction("OP_DEFINE_ARRAY", chunk, offset);
+        case OP_LONG_DEFINE_ARRAY:
+            return longByteInstruction("OP_LONG_DEFINE_ARRAY", chunk, offset);
+        case OP_DEFINE_MAP:
+            return byteInstruction("OP_DEFINE_MAP", chunk, offset);
+        case OP_LONG_DEFINE_MAP:
+            return longByteInstruction("OP_LONG_DEFINE_MAP", chunk, offset);
         case OP_DECLARE_ARRAY:
             return simpleInstruction("OP_DECLARE_ARRAY", offset);
         case OP_MULTI_ARRAY:
-            return simpleInstruction("OP_MULTI_ARRAY", offset);
+            return byteInstruction("OP_MULTI_ARRAY", chunk, offset);
         case OP_SET_ELEMENT:
-            return elementInstruction("OP_SET_ELEMENT", chunk, offset, 1);
+            return simpleInstruction("OP_SET_ELEMENT", offset);
+        case OP_SET_ELEMENT_UNCHECKED:
+            return simpleInstruction("OP_SET_ELEMENT_UNCHECKED", offset);
+        case OP_SET_ELEMENT_2D:
+            return simpleInstruction("OP_SET_ELEMENT_2D", offset);
+        case OP_MODIFY_ELEMENT:
+            printf("%-16s %s\n", "OP_MODIFY_ELEMENT",
+                   operationName(chunk->code[offset + 1]));
+            return offset + 2;
+        case OP_MODIFY_ELEMENT_2D:
+            printf("%-16s %s\n", "OP_MODIFY_ELEMENT_2D",
+                   operationName(chunk->code[offset + 1]));
+            return offset + 2;
+        case OP_CHECK_RANGE: {
+            uint8_t flags = chunk->code[offset + 1];
+            printf("%-16s %s%s\n", "OP_CHECK_RANGE",
+                   flags & RANGE_SUBTRACT ? "i - k" : "i + k",
+                   flags & RANGE_INCLUSIVE ? " <=" : " <");
+            return offset + 2;
+        }
+        case OP_GET_CAPTURED:
+            return byteInstruction("OP_GET_CAPTURED", chunk, offset);
+        case OP_LONG_GET_CAPTURED:
+            return longByteInstruction("OP_LONG_GET_CAPTURED", chunk, offset);
         case OP_GET_UPVALUE:
             return byteInstruction("OP_GET_UPVALUE", chunk, offset);
+        case OP_LONG_GET_UPVALUE:
+            return longByteInstruction("OP_LONG_GET_UPVALUE", chunk, offset);
         case OP_SET_UPVALUE:
             return byteInstruction("OP_SET_UPVALUE", chunk, offset);
+        case OP_LONG_SET_UPVALUE:
+            return longByteInstruction("OP_LONG_SET_UPVALUE", chunk, offset);
+        case OP_INC_UPVALUE:
+            return byteInstruction("OP_INC_UPVALUE", chunk, offset);
+        case OP_LONG_INC_UPVALUE:
+            return longByteInstruction("OP_LONG_INC_UPVALUE", chunk, offset);
+        case OP_DEC_UPVALUE:
+            return byteInstruction("OP_DEC_UPVALUE", chunk, offset);
+        case OP_LONG_DEC_UPVALUE:
+            return longByteInstruction("OP_LONG_DEC_UPVALUE", chunk, offset);
+        case OP_MODIFY_UPVALUE:
+            return modifyInstruction("OP_MODIFY_UPVALUE", false,
+                                     false, chunk, offset);
+        case OP_LONG_MODIFY_UPVALUE:
+            return modifyInstruction("OP_LONG_MODIFY_UPVALUE", true,
+                                     false, chunk, offset);
         case OP_GET_PROPERTY:
             return constantInstruction("OP_GET_PROPERTY", chunk, offset);
+        case OP_LONG_GET_PROPERTY:
+            return longConstantInstruction("OP_LONG_GET_PROPERTY", chunk, offset);
         case OP_SET_PROPERTY:
             return constantInstruction("OP_SET_PROPERTY", chunk, offset);
+        case OP_LONG_SET_PROPERTY:
+            return longConstantInstruction("OP_LONG_SET_PROPERTY", chunk, offset);
+        case OP_MODIFY_PROPERTY:
+            return modifyInstruction("OP_MODIFY_PROPERTY", false,
+                                     true, chunk, offset);
+        case OP_LONG_MODIFY_PROPERTY:
+            return modifyInstruction("OP_LONG_MODIFY_PROPERTY", true,
+                                     true, chunk, offset);
         case OP_GET_SUPER:
             return constantInstruction("OP_GET_SUPER", chunk, offset);
+        case OP_LONG_GET_SUPER:
+            return longConstantInstruction("OP_LONG_GET_SUPER", chunk, offset);
         case OP_EQUAL:
             return simpleInstruction("OP_EQUAL", offset);
         case OP_GREATER:
-            return simpleInstruction("OP_GREATER", offset);
+            return quickenedInstruction("OP_GREATER", chunk, offset);
         case OP_LESS:
-            return simpleInstruction("OP_LESS", offset);
+            return quickenedInstruction("OP_LESS", chunk, offset);
         case OP_ADD:
-            return simpleInstruction("OP_ADD", offset);
+            return quickenedInstruction("OP_ADD", chunk, offset);
         case OP_SUBTRACT:
-            return simpleInstruction("OP_SUBTRACT", offset);
+            return quickenedInstruction("OP_SUBTRACT", chunk, offset);
         case OP_MULTIPLY:
-            return simpleInstruction("OP_MULTIPLY", offset);
+            return quickenedInstruction("OP_MULTIPLY", chunk, offset);
         case OP_MODULO:
             return simpleInstruction("OP_MODULO", offset);
         case OP_INT_DIVIDE:
             return simpleInstruction("OP_INT_DIVIDE", offset);
         case OP_DIVIDE:
-            return simpleInstruction("OP_DIVIDE", offset);
+            return quickenedInstruction("OP_DIVIDE", chunk, offset);
+        case OP_GREATER_NUMBER:
+            return quickenedInstruction("OP_GREATER_NUMBER", chunk, offset);
+        case OP_LESS_NUMBER:
+            return quickenedInstruction("OP_LESS_NUMBER", chunk, offset);
+        case OP_ADD_NUMBER:
+            return quickenedInstruction("OP_ADD_NUMBER", chunk, offset);
+        case OP_ADD_STRING:
+            return quickenedInstruction("OP_ADD_STRING", chunk, offset);
+        case OP_SUBTRACT_NUMBER:
+            return quickenedInstruction("OP_SUBTRACT_NUMBER", chunk, offset);
+        case OP_MULTIPLY_NUMBER:
+            return quickenedInstruction("OP_MULTIPLY_NUMBER", chunk, offset);
+        case OP_DIVIDE_NUMBER:
+            return quickenedInstruction("OP_DIVIDE_NUMBER", chunk, offset);
+        case OP_EQUAL_IMM:
+            return immediateInstruction("OP_EQUAL_IMM", chunk, offset);
+        case OP_GREATER_IMM:
+            return immediateInstruction("OP_GREATER_IMM", chunk, offset);
+        case OP_LESS_IMM:
+            return immediateInstruction("OP_LESS_IMM", chunk, offset);
+        case OP_ADD_IMM:
+            return immediateInstruction("OP_ADD_IMM", chunk, offset);
+        case OP_SUBTRACT_IMM:
+            return immediateInstruction("OP_SUBTRACT_IMM", chunk, offset);
+        case OP_MODULO_IMM:
+            return immediateInstruction("OP_MODULO_IMM", chunk, offset);
+        case OP_MULTIPLY_IMM:
+            return immediateInstruction("OP_MULTIPLY_IMM", chunk, offset);
         case OP_NOT:
             return simpleInstruction("OP_NOT", offset);
         case OP_NEGATE:
             return simpleInstruction("OP_NEGATE", offset);
         case OP_PRINT:
             return simpleInstruction("OP_PRINT", offset);
+        case OP_SWITCH:
+            return switchInstruction("OP_SWITCH", false, chunk, offset);
+        case OP_LONG_SWITCH:
+            return switchInstruction("OP_LONG_SWITCH", true, chunk, offset);
         case OP_JUMP:
             return jumpInstruction("OP_JUMP", 1, chunk, offset);
+        case OP_LONG_JUMP:
+            return longJumpInstruction("OP_LONG_JUMP", 1, chunk, offset);
         case OP_JUMP_IF_FALSE:
             return jumpInstruction("OP_JUMP_IF_ELSE", 1, chunk, offset);
+        case OP_ITERATOR:
+            return simpleInstruction("OP_ITERATOR", offset);
+        case OP_FOR_EACH:
+            return jumpInstruction("OP_FOR_EACH", 1, chunk, offset);
+        case OP_LONG_FOR_EACH:
+            return longJumpInstruction("OP_LONG_FOR_EACH", 1, chunk, offset);
+        case OP_LONG_JUMP_IF_FALSE:
+            return longJumpInstruction("OP_LONG_JUMP_IF_ELSE", 1, chunk, offset);
         case OP_LOOP:
             return jumpInstruction("OP_LOOP", -1, chunk, offset);
+        case OP_LONG_LOOP:
+            return longJumpInstruction("OP_LONG_LOOP", -1, chunk, offset);
         case OP_CALL:
-            return byteInstruction("OP_CALL", chunk, offset);
+            printf("%-16s (%d args) cache %d\n", "OP_CALL",
+                   chunk->code[offset + 1], chunk->code[offset + 2]);
+            return offset + 3;
+        case OP_LONG_CALL:
+            printf("%-16s (%d args) cache %d\n", "OP_LONG_CALL",
+                   chunk->code[offset + 1],
+                   (chunk->code[offset + 2] << 16) |
+                   (chunk->code[offset + 3] << 8) | chunk->code[offset + 4]);
+            return offset + 5;
         case OP_INVOKE:
             return invokeInstruction("OP_INVOKE", chunk, offset);
+        case OP_LONG_INVOKE:
+            return longInvokeInstruction("OP_LONG_INVOKE", chunk, offset);
         case OP_SUPER_INVOKE:
             return invokeInstruction("OP_SUPER_INVOKE", chunk, offset);
-        case OP_CLOSURE: {
-            offset++;
-            uint8_t constant = chunk->code[offset++];
-            printf("%-16s %4d ", "OP_CLOSURE", constant);
-            printValue(chunk->constants.values[constant]);
-            printf("\n");
-
-            ObjFunction* function = AS_FUNCTION(
-                chunk->constants.values[constant]);
-            for (int j = 0; j < function->upvalueCount; j++) {
-                int isLocal = chunk->code[offset++];
-                int index = chunk->code[offset++];
-                printf("%04d      |                     %s %d\n",
-                       offset - 2, isLocal ? "local" : "upvalue", index);
-            }
-            
-            return offset;
-        }
+        case OP_LONG_SUPER_INVOKE:
+            return longInvokeInstruction("OP_LONG_SUPER_INVOKE", chunk, offset);
+        case OP_CLOSURE:
+            return closureInstruction("OP_CLOSURE", false, chunk, offset);
+        case OP_LONG_CLOSURE:
+            return closureInstruction("OP_LONG_CLOSURE", true, chunk, offset);
         case OP_CLOSE_UPVALUE:
             return simpleInstruction("OP_CLOSE_UPVALUE", offset);
         case OP_RETURN:
             return simpleInstruction("OP_RETURN", offset);
         case OP_CLASS:
             return constantInstruction("OP_CLASS", chunk, offset);
+        case OP_LONG_CLASS:
+            return longConstantInstruction("OP_LONG_CLASS", chunk, offset);
         case OP_INHERIT:
             return simpleInstruction("OP_INHERIT", offset);
         case OP_METHOD:
             return constantInstruction("OP_METHOD", chunk, offset);
+        case OP_LONG_METHOD:
+            return longConstantInstruction("OP_LONG_METHOD", chunk, offset);
         default:
             printf("Unknown opcode %d", instruction);
             return offset + 1;
@@ -7,6 +7,9 @@
 #include "debug.h"
 #include "vm.h"
 
+// Set by '--tamad': function bodies are compiled when first called.
+static bool compileLazily = false;
+
 static void repl() {
     char line[1024];
     for (;;) {
@@ -17,7 +20,7 @@ static void repl() {
             break;
         }
 
-        interpret(line);
+        interpret(line, compileLazily);
     }
 }
 
@@ -52,7 +55,7 @@ static char* readFile(const char* path) {
 
 static void runFile(const char* path) {
     char* source = readFile(path);
-    InterpretResult result = interpret(source);
+    InterpretResult result = interpret(source, compileLazily);
     free(source);
 
     if (result == INTERPRET_COMPILE_ERROR) exit(65);
@@ -62,12 +65,18 @@ static void runFile(const char* path) {
 int main(int argc, const char* argv[]) {
     initVM();
 
-    if (argc == 1) {
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--tamad") == 0) {
+        compileLazily = true;
+        arg++;
+    }
+
+    if (arg == argc) {
         repl();
-    } else if (argc == 2) {
-        runFile(argv[1]);
+    } else if (arg + 1 == argc) {
+        runFile(argv[arg]);
     } else {
-        fprintf(stderr, "Tamang pagtawag: awit [lokasyon]");
+        fprintf(stderr, "Tamang pagtawag: awit [--tamad] [lokasyon]");
         exit(64);
     }
 
@@ -38,19 +38,24 @@ void markObject(Obj* object) {
     if (objMark(object) == vm.markValue) return;
 
 #ifdef DEBUG_LOG_GC
+    flushOutput();
     printf("%p mark ", (void*)object);
     printValue(OBJ_VAL(object));
+    flushOutput();
     printf("\n");
 
     if (objType(object) == OBJ_NATIVE || objType(object) == OBJ_STRING) {
         printf("%p mark ", (void*)object);
         printValue(OBJ_VAL(object));
+        flushOutput();
         printf("\n");
     }
 #endif
 
     setMark(object, vm.markValue);
-    if (objType(object) == OBJ_NATIVE || objType(object) == OBJ_STRING)
+    if (objType(object) == OBJ_NATIVE || objType(object) == OBJ_RANGE ||
+        objType(object) == OBJ_STRING ||
+        objType(object) == OBJ_STRING_BUILDER)
         return;
 
     if (vm.grayCapacity < vm.grayCount + 1) {
@@ -76,8 +81,10 @@ static void markArray(ValueArray* array) {
 
 static void blackenObject(Obj* object) {
 #ifdef DEBUG_LOG_GC
+    flushOutput();
     printf("%p blacken ", (void*)object);
     printValue(OBJ_VAL(object));
+    flushOutput();
     printf("\n");
 #endif
 
@@ -103,14 +110,39 @@ static void blackenObject(Obj* object) {
             ObjClosure* closure = (ObjClosure*)object;
             markObject((Obj*)closure->function);
             for (int i = 0; i < closure->upvalueCount; i++) {
-                markObject((Obj*)closure->upvalues[i]);
+                markValue(closure->upvalues[i]);
             }
             break;
         }
         case OBJ_FUNCTION: {
             ObjFunction* function = (ObjFunction*)object;
             markObject((Obj*)function->name);
+            markObject((Obj*)function->source);
+            markArray(&function->upvalueNames);
             markArray(&function->chunk.constants);
+            for (int i = 0; i < function->chunk.switchCount; i++) {
+                markValueTable(&function->chunk.switches[i].cases);
+            }
+            for (int i = 0; i < function->chunk.callCount; i++) {
+                markObject(function->chunk.calls[i].callee);
+            }
+            for (int i = 0; i < function->chunk.inlinedCount; i++) {
+                markObject((Obj*)function->chunk.inlined[i].name);
+            }
+            break;
+        }
+        case OBJ_GRID: {
+            // A view keeps its owner, which marks all the elements.
+            ObjGrid* grid = (ObjGrid*)object;
+            if (grid->owner != NULL) {
+                markObject((Obj*)grid->owner);
+                break;
+            }
+
+            int count = grid->sizes[0] * grid->strides[0];
+            for (int i = 0; i < count; i++) {
+                markValue(grid->values[i]);
+            }
             break;
         }
         case OBJ_INSTANCE: {
@@ -119,11 +151,32 @@ static void blackenObject(Obj* object) {
             markTable(&instance->fields);
             break;
         }
+        case OBJ_DEQUE: {
+            ObjDeque* deque = (ObjDeque*)object;
+            for (int i = 0; i < deque->count; i++) {
+                markValue(deque->values[(deque->head + i) % deque->capacity]);
+            }
+            break;
+        }
+        case OBJ_HEAP: {
+            ObjHeap* heap = (ObjHeap*)object;
+            markArray(&heap->elements);
+            markValue(heap->comparator);
+            break;
+        }
+        case OBJ_MAP:
+            markValueTable(&((ObjMap*)object)->table);
+            break;
+        case OBJ_SET:
+            markValueTable(&((ObjSet*)object)->table);
+            break;
         case OBJ_UPVALUE:
             markValue(((ObjUpvalue*)object)->closed);
             break;
         case OBJ_STRING:
+        case OBJ_STRING_BUILDER:
         case OBJ_NATIVE:
+        case OBJ_RANGE:
             break; // Unreachable. Handled by the caller's if-statement.
     }
 }
@@ -134,11 +187,12 @@ static void freeObject(Obj* object) {
 #endif
 
     switch (objType(object)) {
-        case OBJ_ARRAY:
-            //ObjArray* array = (ObjArray*)object;
-            //freeValueArray(&array->elements);
+        case OBJ_ARRAY: {
+            ObjArray* array = (ObjArray*)object;
+            freeValueArray(&array->elements);
             FREE(ObjArray, object);
             break;
+        }
         case OBJ_BOUND_METHOD:
             FREE(ObjBoundMethod, object);
             break;
@@ -150,30 +204,74 @@ static void freeObject(Obj* object) {
         }
         case OBJ_CLOSURE: {
             ObjClosure* closure = (ObjClosure*)object;
-            FREE_ARRAY(ObjClosure*, closure->upvalues,
+            FREE_ARRAY(Value, closure->upvalues,
                 closure->upvalueCount);
             FREE(ObjClosure, object);
             break;
         }
+        case OBJ_DEQUE: {
+            ObjDeque* deque = (ObjDeque*)object;
+            FREE_ARRAY(Value, deque->values, deque->capacity);
+            FREE(ObjDeque, object);
+            break;
+        }
         case OBJ_FUNCTION: {
             ObjFunction* function = (ObjFunction*)object;
             freeChunk(&function->chunk);
+            freeValueArray(&function->upvalueNames);
             FREE(ObjFunction, object);
             break;
         }
+        case OBJ_GRID: {
+            ObjGrid* grid = (ObjGrid*)object;
+            if (grid->owner == NULL) {
+                FREE_ARRAY(Value, grid->values,
+                    grid->sizes[0] * grid->strides[0]);
+                FREE_ARRAY(int, grid->sizes, grid->dimensions * 2);
+            }
+            FREE(ObjGrid, object);
+            break;
+        }
+        case OBJ_HEAP: {
+            ObjHeap* heap = (ObjHeap*)object;
+            freeValueArray(&heap->elements);
+            FREE(ObjHeap, object);
+            break;
+        }
         case OBJ_INSTANCE: {
             ObjInstance* instance = (ObjInstance*)object;
             freeTable(&instance->fields);
             FREE(ObjInstance, object);
             break;
         }
+        case OBJ_MAP: {
+            ObjMap* map = (ObjMap*)object;
+            freeValueTable(&map->table);
+            FREE(ObjMap, object);
+            break;
+        }
         case OBJ_NATIVE:
             FREE(ObjNative, object);
             break;
+        case OBJ_RANGE:
+            FREE(ObjRange, object);
+            break;
+        case OBJ_SET: {
+            ObjSet* set = (ObjSet*)object;
+            freeValueTable(&set->table);
+            FREE(ObjSet, object);
+            break;
+        }
         case OBJ_STRING: {
             FREE(ObjString, object);
             break;
         }
+        case OBJ_STRING_BUILDER: {
+            ObjStringBuilder* builder = (ObjStringBuilder*)object;
+            FREE_ARRAY(char, builder->chars, builder->capacity);
+            FREE(ObjStringBuilder, object);
+            break;
+        }
         case OBJ_UPVALUE:
             FREE(ObjUpvalue, object);
             break;
@@ -198,6 +296,9 @@ static void markRoots() {
     markTable(&vm.globals);
     markCompilerRoots();
     markObject((Obj*)vm.initString);
+    for (int i = 0; i < UINT8_COUNT; i++) {
+        markObject((Obj*)vm.charStrings[i]);
+    }
 }
 
 static void traceReferences() {
@@ -45,10 +45,9 @@ ObjClass* newClass(ObjString* name) {
 }
 
 ObjClosure* newClosure(ObjFunction* function) {
-    ObjUpvalue** upvalues = ALLOCATE(ObjUpvalue*,
-                                     function->upvalueCount);
+    Value* upvalues = ALLOCATE(Value, function->upvalueCount);
     for (int i = 0; i < function->upvalueCount; i++) {
-        upvalues[i] = NULL;
+        upvalues[i] = NULL_VAL;
     }
 
     ObjClosure* closure = ALLOCATE_OBJ(ObjClosure, OBJ_CLOSURE);
@@ -58,15 +57,71 @@ ObjClosure* newClosure(ObjFunction* function) {
     return closure;
 }
 
+ObjDeque* newDeque() {
+    ObjDeque* deque = ALLOCATE_OBJ(ObjDeque, OBJ_DEQUE);
+    deque->values = NULL;
+    deque->capacity = 0;
+    deque->head = 0;
+    deque->count = 0;
+    return deque;
+}
+
 ObjFunction* newFunction() {
     ObjFunction* function = ALLOCATE_OBJ(ObjFunction, OBJ_FUNCTION);
     function->arity = 0;
     function->upvalueCount = 0;
+    function->slotCount = 0;
     function->name = NULL;
+    function->source = NULL;
+    function->line = 0;
+    initValueArray(&function->upvalueNames);
     initChunk(&function->chunk);
     return function;
 }
 
+// The sizes are already checked to not overflow an int when multiplied.
+ObjGrid* newGrid(int dimensions, int* sizes) {
+    int* shape = ALLOCATE(int, dimensions * 2);
+    int count = 1;
+    for (int i = dimensions - 1; i >= 0; i--) {
+        shape[i] = sizes[i];
+        shape[dimensions + i] = count;
+        count *= sizes[i];
+    }
+
+    Value* values = ALLOCATE(Value, count);
+    for (int i = 0; i < count; i++) {
+        values[i] = NULL_VAL;
+    }
+
+    ObjGrid* grid = ALLOCATE_OBJ(ObjGrid, OBJ_GRID);
+    grid->owner = NULL;
+    grid->values = values;
+    grid->dimensions = dimensions;
+    grid->sizes = shape;
+    grid->strides = shape + dimensions;
+    return grid;
+}
+
+// The part of grid at offset without its first skip dimensions. The grid
+// has to stay reachable until the view is made.
+ObjGrid* newGridView(ObjGrid* grid, int skip, int offset) {
+    ObjGrid* view = ALLOCATE_OBJ(ObjGrid, OBJ_GRID);
+    view->owner = grid->owner != NULL ? grid->owner : grid;
+    view->values = grid->values + offset;
+    view->dimensions = grid->dimensions - skip;
+    view->sizes = grid->sizes + skip;
+    view->strides = grid->strides + skip;
+    return view;
+}
+
+ObjHeap* newHeap(Value comparator) {
+    ObjHeap* heap = ALLOCATE_OBJ(ObjHeap, OBJ_HEAP);
+    initValueArray(&heap->elements);
+    heap->comparator = comparator;
+    return heap;
+}
+
 ObjInstance* newInstance(ObjClass* klass) {
     ObjInstance* instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
     instance->klass = klass;
@@ -74,14 +129,41 @@ ObjInstance* newInstance(ObjClass* klass) {
     return instance;
 }
 
-ObjNative* newNative(NativeFn function) {
+ObjMap* newMap() {
+    ObjMap* map = ALLOCATE_OBJ(ObjMap, OBJ_MAP);
+    initValueTable(&map->table);
+    map->count = 0;
+    return map;
+}
+
+ObjNative* newNative(NativeFn function, NativeCheck check,
+                     int minArity, int maxArity, uint8_t flags) {
     ObjNative* native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
     native->function = function;
+    native->check = check;
+    native->minArity = minArity;
+    native->maxArity = maxArity;
+    native->flags = flags;
     return native;
 }
 
-static uint32_t hashString(const char* key, int length) {
-    uint32_t hash = 2166136261u;
+ObjSet* newSet() {
+    ObjSet* set = ALLOCATE_OBJ(ObjSet, OBJ_SET);
+    initValueTable(&set->table);
+    set->count = 0;
+    return set;
+}
+
+ObjRange* newRange(double start, double end) {
+    ObjRange* range = ALLOCATE_OBJ(ObjRange, OBJ_RANGE);
+    range->start = start;
+    range->end = end;
+    return range;
+}
+
+// FNV-1a can be continued from the hash of the chars before key, so
+// hashString(ab) == hashStringFrom(hashString(a), b).
+uint32_t hashStringFrom(uint32_t hash, const char* key, int length) {
     for (int i = 0; i < length; i++) {
         hash ^= (uint8_t)key[i];
         hash *= 16777619;
@@ -89,6 +171,10 @@ static uint32_t hashString(const char* key, int length) {
     return hash;
 }
 
+static uint32_t hashString(const char* key, int length) {
+    return hashStringFrom(2166136261u, key, length);
+}
+
 ObjString* makeString(int length) {
     ObjString* string = (ObjString*)allocateObject(
         sizeof(ObjString) + length + 1, OBJ_STRING);
@@ -114,6 +200,31 @@ ObjString* copyString(const char* chars, int length) {
     return string;
 }
 
+// Takes a string filled in after makeString along with the hash of its
+// chars and returns the interned one, so it compares equal with every
+// other string of the same chars.
+ObjString* internString(ObjString* string, uint32_t hash) {
+    string->hash = hash;
+    ObjString* interned = tableFindString(&vm.strings, string->chars,
+                                          string->length, string->hash);
+    if (interned != NULL) return interned;
+
+    push(OBJ_VAL(string));
+    tableSet(&vm.strings, string, NULL_VAL);
+    pop();
+
+    return string;
+}
+
+ObjStringBuilder* newStringBuilder() {
+    ObjStringBuilder* builder =
+        ALLOCATE_OBJ(ObjStringBuilder, OBJ_STRING_BUILDER);
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    return builder;
+}
+
 ObjUpvalue* newUpvalue(Value* slot) {
     ObjUpvalue* upvalue = ALLOCATE_OBJ(ObjUpvalue, OBJ_UPVALUE);
     upvalue->closed = NULL_VAL;
@@ -124,20 +235,75 @@ ObjUpvalue* newUpvalue(Value* slot) {
 
 static void printFunction(ObjFunction* function) {
     if (function->name == NULL) {
-        printf("<skrip>");
+        writeOutput("<skrip>");
         return;
     }
-    printf("<gwn %s>", function->name->chars);
+    writeOutput("<gwn %s>", function->name->chars);
 }
 
 static void printArray(ValueArray array) {
-    printf("[");
+    writeOutput("[");
     for (int i = 0; i < array.count; i++) {
         printValue(array.values[i]);
-        printf(",");
+        writeOutput(",");
     }
     
-    printf("\b]");
+    writeOutput("\b]");
+}
+
+static void printGrid(Value* values, int dimensions, int* sizes,
+                      int* strides) {
+    writeOutput("[");
+    for (int i = 0; i < sizes[0]; i++) {
+        if (dimensions == 1) {
+            printValue(values[i]);
+        } else {
+            printGrid(values + i * strides[0], dimensions - 1, sizes + 1,
+                      strides + 1);
+        }
+        writeOutput(",");
+    }
+
+    writeOutput("\b]");
+}
+
+static void printDeque(ObjDeque* deque) {
+    writeOutput("pila[");
+    for (int i = 0; i < deque->count; i++) {
+        if (i > 0) writeOutput(", ");
+        printValue(deque->values[(deque->head + i) % deque->capacity]);
+    }
+    writeOutput("]");
+}
+
+static void printSet(ObjSet* set) {
+    writeOutput("kalipunan{");
+    bool isFirst = true;
+    for (int i = 0; i < set->table.capacity; i++) {
+        Value key = set->table.entries[i].key;
+        if (IS_NULL(key)) continue;
+
+        if (!isFirst) writeOutput(", ");
+        isFirst = false;
+        printValue(key);
+    }
+    writeOutput("}");
+}
+
+static void printMap(ObjMap* map) {
+    writeOutput("{");
+    bool isFirst = true;
+    for (int i = 0; i < map->table.capacity; i++) {
+        ValueEntry* entry = &map->table.entries[i];
+        if (IS_NULL(entry->key)) continue;
+
+        if (!isFirst) writeOutput(", ");
+        isFirst = false;
+        printValue(entry->key);
+        writeOutput(": ");
+        printValue(entry->value);
+    }
+    writeOutput("}");
 }
 
 void printObject(Value value) {
@@ -149,27 +315,56 @@ void printObject(Value value) {
             printFunction(AS_BOUND_METHOD(value)->method->function);
             break;
         case OBJ_CLASS:
-            printf("%s", AS_CLASS(value)->name->chars);
+            writeOutput("%s", AS_CLASS(value)->name->chars);
             break;
         case OBJ_CLOSURE:
             printFunction(AS_CLOSURE(value)->function);
             break;
+        case OBJ_DEQUE:
+            printDeque(AS_DEQUE(value));
+            break;
         case OBJ_FUNCTION:
             printFunction(AS_FUNCTION(value));
             break;
+        case OBJ_GRID: {
+            ObjGrid* grid = AS_GRID(value);
+            printGrid(grid->values, grid->dimensions, grid->sizes,
+                      grid->strides);
+            break;
+        }
+        case OBJ_HEAP:
+            writeOutput("tambak(%d)", AS_HEAP(value)->elements.count);
+            break;
         case OBJ_INSTANCE:
-            printf("%s instansya",
+            writeOutput("%s instansya",
                    AS_INSTANCE(value)->klass->name->chars);
             break;
+        case OBJ_MAP:
+            printMap(AS_MAP(value));
+            break;
         case OBJ_NATIVE:
             // Katutubong gawain.
-            printf("<kttb gwn>");
+            writeOutput("<kttb gwn>");
+            break;
+        case OBJ_RANGE:
+            writeOutput("saklaw(%g, %g)", AS_RANGE(value)->start,
+                   AS_RANGE(value)->end);
+            break;
+        case OBJ_SET:
+            printSet(AS_SET(value));
             break;
         case OBJ_STRING:
-            printf("%.*s", AS_STRING(value)->length, AS_CSTRING(value));
+            writeChars(AS_CSTRING(value), AS_STRING(value)->length);
             return;
+        case OBJ_STRING_BUILDER: {
+            ObjStringBuilder* builder = AS_STRING_BUILDER(value);
+            if (builder->length > 0) {
+                writeChars(builder->chars, builder->length);
+            }
+            break;
+        }
         case OBJ_UPVALUE:
-            printf("upvalue");
+            writeOutput("upvalue");
             break;
     }
 }
@@ -12,20 +12,35 @@
 #define IS_BOUND_METHOD(value) isObjType(value, OBJ_BOUND_METHOD)
 #define IS_CLASS(value)        isObjType(value, OBJ_CLASS)
 #define IS_CLOSURE(value)      isObjType(value, OBJ_CLOSURE)
+#define IS_DEQUE(value)        isObjType(value, OBJ_DEQUE)
 #define IS_FUNCTION(value)     isObjType(value, OBJ_FUNCTION)
+#define IS_GRID(value)         isObjType(value, OBJ_GRID)
+#define IS_HEAP(value)         isObjType(value, OBJ_HEAP)
 #define IS_INSTANCE(value)     isObjType(value, OBJ_INSTANCE)
+#define IS_MAP(value)          isObjType(value, OBJ_MAP)
 #define IS_NATIVE(value)       isObjType(value, OBJ_NATIVE)
+#define IS_RANGE(value)        isObjType(value, OBJ_RANGE)
+#define IS_SET(value)          isObjType(value, OBJ_SET)
 #define IS_STRING(value)       isObjType(value, OBJ_STRING)
+#define IS_STRING_BUILDER(value) isObjType(value, OBJ_STRING_BUILDER)
 
 #define AS_ARRAY(value)        ((ObjArray*)AS_OBJ(value))
 #define AS_BOUND_METHOD(value) ((ObjBoundMethod*)AS_OBJ(value))
 #define AS_CLASS(value)        ((ObjClass*)AS_OBJ(value))
 #define AS_CLOSURE(value)      ((ObjClosure*)AS_OBJ(value))
+#define AS_DEQUE(value)        ((ObjDeque*)AS_OBJ(value))
 #define AS_FUNCTION(value)     ((ObjFunction*)AS_OBJ(value))
+#define AS_GRID(value)         ((ObjGrid*)AS_OBJ(value))
+#define AS_HEAP(value)         ((ObjHeap*)AS_OBJ(value))
 #define AS_INSTANCE(value)     ((ObjInstance*)AS_OBJ(value))
+#define AS_MAP(value)          ((ObjMap*)AS_OBJ(value))
 #define AS_NATIVE(value) \
     (((ObjNative*)AS_OBJ(value))->function)
+#define AS_RANGE(value)        ((ObjRange*)AS_OBJ(value))
+#define AS_SET(value)          ((ObjSet*)AS_OBJ(value))
 #define AS_STRING(value)       ((ObjString*)AS_OBJ(value))
+#define AS_STRING_BUILDER(value) ((ObjStringBuilder*)AS_OBJ(value))
+#define AS_UPVALUE(value)      ((ObjUpvalue*)AS_OBJ(value))
 #define AS_CSTRING(value)      (((ObjString*)AS_OBJ(value))->chars)
 
 typedef enum {
@@ -33,10 +48,17 @@ typedef enum {
     OBJ_BOUND_METHOD,
     OBJ_CLASS,
     OBJ_CLOSURE,
+    OBJ_DEQUE,
     OBJ_FUNCTION,
+    OBJ_GRID,
+    OBJ_HEAP,
     OBJ_INSTANCE,
+    OBJ_MAP,
     OBJ_NATIVE,
+    OBJ_RANGE,
+    OBJ_SET,
     OBJ_STRING,
+    OBJ_STRING_BUILDER,
     OBJ_UPVALUE
 } ObjType;
 
@@ -51,15 +73,43 @@ typedef struct {
     Obj obj;
     int arity;
     int upvalueCount;
+    int slotCount;
     Chunk chunk;
     ObjString* name;
+
+    // Until a lazily compiled function is first called, source holds its
+    // text from '(' to '}' and upvalueNames the names its upvalues were
+    // captured for. Both are cleared once it is compiled.
+    ObjString* source;
+    int line;
+    ValueArray upvalueNames;
 } ObjFunction;
 
+// A native is only called with an argument count in its arity range,
+// which the VM checks. It can report a runtime error like the VM does,
+// after which its return value is ignored.
 typedef Value (*NativeFn)(int argCount, Value* args);
 
+// The error a native would report for the arguments, or NULL. It is run
+// before the native, so the compiler can tell a call it may fold.
+typedef const char* (*NativeCheck)(int argCount, Value* args);
+
+// The compiler reads these when it folds a call with constant arguments.
+#define NATIVE_PURE     0x1 // Same result for the same arguments, without
+                            // side effects. Errors only come from its
+                            // check. May be folded.
+#define NATIVE_ALLOCATE 0x2 // May allocate objects and trigger the GC, so
+                            // its arguments have to be kept on the stack.
+#define NATIVE_REENTER  0x4 // May call back into the script, so it is never
+                            // folded.
+
 typedef struct {
     Obj obj;
     NativeFn function;
+    NativeCheck check;
+    int minArity;
+    int maxArity;
+    uint8_t flags;
 } ObjNative;
 
 struct ObjString {
@@ -69,6 +119,15 @@ struct ObjString {
     char chars[];
 };
 
+// A tagabuo (string builder). Its chars grow in place and are only
+// interned once they are made into a string.
+typedef struct {
+    Obj obj;
+    char* chars;
+    int length;
+    int capacity;
+} ObjStringBuilder;
+
 typedef struct ObjUpvalue {
     Obj obj;
     Value* location;
@@ -79,7 +138,9 @@ typedef struct ObjUpvalue {
 typedef struct {
     Obj obj;
     ObjFunction* function;
-    ObjUpvalue** upvalues;
+    // A captured variable that is never reassigned holds its value
+    // directly, the others hold their ObjUpvalue.
+    Value* upvalues;
     int upvalueCount;
 } ObjClosure;
 
@@ -106,15 +167,80 @@ typedef struct {
     ValueArray elements;
 } ObjArray;
 
+// A diksyunaryo made by '{susi: halaga}'. The table also counts its
+// tombstones so the number of keys is kept apart.
+typedef struct {
+    Obj obj;
+    ValueTable table;
+    int count;
+} ObjMap;
+
+// A kalipunan (set). Its members are the keys of the table.
+typedef struct {
+    Obj obj;
+    ValueTable table;
+    int count;
+} ObjSet;
+
+// A pila (double-ended queue) kept in a ring buffer, so adding and
+// taking at either end doesn't move the other elements.
+typedef struct {
+    Obj obj;
+    Value* values;
+    int capacity;
+    int head;               // Index of the first element.
+    int count;
+} ObjDeque;
+
+// A tambak (priority queue) kept as a binary heap in elements, with the
+// element that goes first at index 0. The comparator is null for the
+// natural order of numbers or strings.
+typedef struct {
+    Obj obj;
+    ValueArray elements;
+    Value comparator;
+} ObjHeap;
+
+// A collection made by 'kilalanin a[n][m]...' with its elements stored
+// row after row in one block. Indexing it by fewer indexes than it has
+// dimensions gives a view that shares the elements of its owner.
+typedef struct ObjGrid {
+    Obj obj;
+    struct ObjGrid* owner;  // NULL for the grid that owns the elements.
+    Value* values;
+    int dimensions;
+    int* sizes;
+    int* strides;           // Elements from one index to the next.
+} ObjGrid;
+
+// The numbers from start up to but not including end, produced one at
+// a time instead of being stored.
+typedef struct {
+    Obj obj;
+    double start;
+    double end;
+} ObjRange;
+
 ObjArray* newArray();
 ObjBoundMethod* newBoundMethod(Value receiver, ObjClosure* method);
 ObjClass* newClass(ObjString* name);
 ObjClosure* newClosure(ObjFunction* function);
+ObjDeque* newDeque();
 ObjFunction* newFunction();
+ObjGrid* newGrid(int dimensions, int* sizes);
+ObjGrid* newGridView(ObjGrid* grid, int skip, int offset);
+ObjHeap* newHeap(Value comparator);
 ObjInstance* newInstance(ObjClass* klass);
-ObjNative* newNative(NativeFn function);
+ObjMap* newMap();
+ObjNative* newNative(NativeFn function, NativeCheck check,
+                     int minArity, int maxArity, uint8_t flags);
+ObjRange* newRange(double start, double end);
+ObjSet* newSet();
 ObjString* makeString(int length);
 ObjString* copyString(const char* chars, int length);
+ObjString* internString(ObjString* string, uint32_t hash);
+uint32_t hashStringFrom(uint32_t hash, const char* key, int length);
+ObjStringBuilder* newStringBuilder();
 ObjUpvalue* newUpvalue(Value* slot);
 void printObject(Value value);
 
@@ -146,7 +272,6 @@ static inline void setType(Obj* object, ObjType type) {
 }
 
 static inline bool isObjType(Value value, ObjType type) {
-    ObjType objTYPE = objType(AS_OBJ(value));
     return IS_OBJ(value) && objType(AS_OBJ(value)) == type;
 }
 
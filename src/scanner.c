@@ -6,12 +6,6 @@
 
 #define TAB_SPACE 4
 
-typedef struct {
-    const char* start;
-    const char* current;
-    int line;
-} Scanner;
-
 Scanner scanner;
 
 void initScanner(const char* source) {
@@ -20,6 +14,14 @@ void initScanner(const char* source) {
     scanner.line = 1;
 }
 
+Scanner saveScanner() {
+    return scanner;
+}
+
+void restoreScanner(Scanner state) {
+    scanner = state;
+}
+
 static bool isAlpha(char c) {
     return (c >= 'a' && c <= 'z') ||
             (c >= 'A' && c <= 'Z') ||
@@ -154,6 +156,7 @@ static TokenType identifierType() {
                         }
                     }
                     case 'i': return checkKeyword(2, 7, "lalanin", TOKEN_KILALANIN);
+                    case 'o': return checkKeyword(2, 3, "nst", TOKEN_KONST);
                     case 'u': 
                         switch (scanner.start[3]) {
                             case 'd': return checkKeyword(2, 6, "ndiman", TOKEN_KUNDIMAN);
@@ -236,13 +239,19 @@ Token scanToken() {
         case ',':  return makeToken(TOKEN_KUWIT);
         case '.':  return makeToken(TOKEN_TULDOK);
         case '\\': return makeToken(TOKEN_ATRAS_PAHILIS);
-        case '/':  return makeToken(TOKEN_SULONG_PAHILIS);
-        case '*':  return makeToken(TOKEN_BITUIN);
+        case '/':
+            return makeToken(
+                match('=') ? TOKEN_SULONG_PAHILIS_KATUMBAS : TOKEN_SULONG_PAHILIS);
+        case '*':
+            return makeToken(
+                match('=') ? TOKEN_BITUIN_KATUMBAS : TOKEN_BITUIN);
         case '%':  return makeToken(TOKEN_MODULO);
         case '-': 
+            if (match('=')) return makeToken(TOKEN_BAWAS_KATUMBAS);
             return makeToken(
                 match('-') ? TOKEN_BAWAS_ISA : TOKEN_BAWAS);
         case '+': 
+            if (match('=')) return makeToken(TOKEN_DAGDAG_KATUMBAS);
             return makeToken(
                 match('+') ? TOKEN_DAGDAG_ISA : TOKEN_DAGDAG);
         case '!':
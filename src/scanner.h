@@ -10,8 +10,9 @@ typedef enum {
     TOKEN_ATRAS_PAHILIS, TOKEN_SULONG_PAHILIS,
     TOKEN_BITUIN, TOKEN_MODULO, TOKEN_TUTULDOK,
     // One or two character tokens.
-    TOKEN_BAWAS, TOKEN_BAWAS_ISA,
-    TOKEN_DAGDAG, TOKEN_DAGDAG_ISA,
+    TOKEN_BAWAS, TOKEN_BAWAS_ISA, TOKEN_BAWAS_KATUMBAS,
+    TOKEN_DAGDAG, TOKEN_DAGDAG_ISA, TOKEN_DAGDAG_KATUMBAS,
+    TOKEN_BITUIN_KATUMBAS, TOKEN_SULONG_PAHILIS_KATUMBAS,
     TOKEN_HINDI, TOKEN_HINDI_PAREHO,
     TOKEN_KATUMBAS, TOKEN_PAREHO,
     TOKEN_HIGIT, TOKEN_HIGIT_PAREHO,
@@ -21,7 +22,7 @@ typedef enum {
     // Keywords.
     TOKEN_AT, TOKEN_GAWAIN, TOKEN_GAWIN, TOKEN_HABANG,
     TOKEN_IBALIK, TOKEN_IPAKITA, TOKEN_ITIGIL, TOKEN_ITO,
-    TOKEN_ITULOY, TOKEN_KADA, TOKEN_KAPAG, TOKEN_KILALANIN, 
+    TOKEN_ITULOY, TOKEN_KADA, TOKEN_KAPAG, TOKEN_KILALANIN, TOKEN_KONST,
     TOKEN_KUNDIMAN, TOKEN_KUNG, TOKEN_MALI, TOKEN_MULA, 
     TOKEN_NULL, TOKEN_PALYA, TOKEN_SURIIN, TOKEN_O,
     TOKEN_TAMA, TOKEN_URI,
@@ -36,7 +37,15 @@ typedef struct {
     int line;
 } Token;
 
+typedef struct {
+    const char* start;
+    const char* current;
+    int line;
+} Scanner;
+
 void initScanner(const char* soure);
+Scanner saveScanner();
+void restoreScanner(Scanner state);
 Token scanToken();
 
 #endif
@@ -152,3 +152,135 @@ void markTable(Table* table) {
         markValue(entry->value);
     }
 }
+
+void initValueTable(ValueTable* table) {
+    table->count = 0;
+    table->capacity = 0;
+    table->entries = NULL;
+}
+
+void freeValueTable(ValueTable* table) {
+    FREE_ARRAY(ValueEntry, table->entries, table->capacity);
+    initValueTable(table);
+}
+
+static uint32_t hashDouble(double value) {
+    // -0 and 0 are equal so they must land on the same bucket.
+    if (value == 0) value = 0;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static uint32_t hashValue(Value value) {
+    switch (value.type) {
+        case VAL_BOOL:   return AS_BOOL(value) ? 3 : 5;
+        case VAL_NULL:   return 7;
+        case VAL_NUMBER: return hashDouble(AS_NUMBER(value));
+        case VAL_OBJ:
+            if (IS_STRING(value)) return AS_STRING(value)->hash;
+            // Equal views of a grid share where their elements start.
+            if (IS_GRID(value)) {
+                return (uint32_t)((uintptr_t)AS_GRID(value)->values >> 3);
+            }
+            // Other objects are compared by identity.
+            return (uint32_t)((uintptr_t)AS_OBJ(value) >> 3);
+        default:         return 0; // Unreachable.
+    }
+}
+
+static ValueEntry* findValueEntry(ValueEntry* entries, int capacity,
+                                  Value key) {
+    uint32_t index = hashValue(key) % capacity;
+    ValueEntry* tombstone = NULL;
+
+    for (;;) {
+        ValueEntry* entry = &entries[index];
+        if (IS_NULL(entry->key)) {
+            if (IS_NULL(entry->value)) {
+                // Empty entry.
+                return tombstone != NULL ? tombstone : entry;
+            } else {
+                // We found a tombstone.
+                if (tombstone == NULL) tombstone = entry;
+            }
+        } else if (valuesEqual(entry->key, key)) {
+            // We found the key.
+            return entry;
+        }
+
+        index = (index + 1) % capacity;
+    }
+}
+
+bool valueTableGet(ValueTable* table, Value key, Value* value) {
+    if (table->count == 0) return false;
+
+    ValueEntry* entry = findValueEntry(table->entries, table->capacity, key);
+    if (IS_NULL(entry->key)) return false;
+
+    *value = entry->value;
+    return true;
+}
+
+static void adjustValueCapacity(ValueTable* table, int capacity) {
+    ValueEntry* entries = ALLOCATE(ValueEntry, capacity);
+    for (int i = 0; i < capacity; i++) {
+        entries[i].key = NULL_VAL;
+        entries[i].value = NULL_VAL;
+    }
+
+    table->count = 0;
+    for (int i = 0; i < table->capacity; i++) {
+        ValueEntry* entry = &table->entries[i];
+        if (IS_NULL(entry->key)) continue;
+
+        ValueEntry* dest = findValueEntry(entries, capacity, entry->key);
+        dest->key = entry->key;
+        dest->value = entry->value;
+        table->count++;
+    }
+
+    FREE_ARRAY(ValueEntry, table->entries, table->capacity);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+bool valueTableSet(ValueTable* table, Value key, Value value) {
+    if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
+        int capacity = GROW_CAPACITY(table->capacity);
+        adjustValueCapacity(table, capacity);
+    }
+
+    ValueEntry* entry = findValueEntry(table->entries, table->capacity, key);
+    bool isNewKey = IS_NULL(entry->key);
+    if (isNewKey && IS_NULL(entry->value)) table->count++;
+
+    entry->key = key;
+    entry->value = value;
+    return isNewKey;
+}
+
+bool valueTableDelete(ValueTable* table, Value key) {
+    if (table->count == 0) return false;
+
+    ValueEntry* entry = findValueEntry(table->entries, table->capacity, key);
+    if (IS_NULL(entry->key)) return false;
+
+    // Place a tombstone in the entry.
+    entry->key = NULL_VAL;
+    entry->value = BOOL_VAL(true);
+    return true;
+}
+
+void markValueTable(ValueTable* table) {
+    for (int i = 0; i < table->capacity; i++) {
+        ValueEntry* entry = &table->entries[i];
+        markValue(entry->key);
+        markValue(entry->value);
+    }
+}
@@ -15,6 +15,19 @@ typedef struct {
     Entry* entries;
 } Table;
 
+// Same open addressing scheme as Table but keyed by any Value. A null
+// key marks an empty entry (or a tombstone) so null cannot be a key.
+typedef struct {
+    Value key;
+    Value value;
+} ValueEntry;
+
+typedef struct {
+    int count;
+    int capacity;
+    ValueEntry* entries;
+} ValueTable;
+
 void initTable(Table* table);
 void freeTable(Table* table);
 bool tableGet(Table* table, ObjString* key, Value* value);
@@ -26,4 +39,11 @@ ObjString* tableFindString(Table* table, const char* chars,
 void tableRemoveWhite(Table* table);
 void markTable(Table* table);
 
+void initValueTable(ValueTable* table);
+void freeValueTable(ValueTable* table);
+bool valueTableGet(ValueTable* table, Value key, Value* value);
+bool valueTableSet(ValueTable* table, Value key, Value value);
+bool valueTableDelete(ValueTable* table, Value key);
+void markValueTable(ValueTable* table);
+
 #endif
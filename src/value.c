@@ -1,9 +1,11 @@
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "value.h"
 #include "object.h"
 #include "memory.h"
+#include "vm.h"
 
 void initValueArray(ValueArray* array) {
     array->count = 0;
@@ -40,24 +42,57 @@ void freeValueArray(ValueArray* array) {
     initValueArray(array);
 }
 
+static void printNumber(double number) {
+    // Whole numbers that %g shows in full are the most common, and can be
+    // written out without formatting.
+    if (number > -1e6 && number < 1e6 && number == (int)number &&
+        !(number == 0 && signbit(number))) {
+        char digits[8];
+        char* start = digits + sizeof(digits);
+        int whole = (int)number;
+        int rest = whole < 0 ? -whole : whole;
+        do {
+            *--start = '0' + rest % 10;
+            rest /= 10;
+        } while (rest > 0);
+        if (whole < 0) *--start = '-';
+
+        writeChars(start, (int)(digits + sizeof(digits) - start));
+        return;
+    }
+
+    writeOutput("%g", number);
+}
+
 void printValue(Value value) {
     switch (value.type) {
         case VAL_BOOL:
-            printf(AS_BOOL(value) ? "tama" : "mali");
+            writeOutput(AS_BOOL(value) ? "tama" : "mali");
             break;
-        case VAL_NULL: printf("null"); break;
-        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
+        case VAL_NULL: writeOutput("null"); break;
+        case VAL_NUMBER: printNumber(AS_NUMBER(value)); break;
         case VAL_OBJ: printObject(value); break;
     }
 }
 
+// Each a[i] on a grid makes a new view of that row, so views of the same
+// part of the same grid are the same value.
+static bool gridsEqual(ObjGrid* a, ObjGrid* b) {
+    return a == b || (a->owner != NULL && a->owner == b->owner &&
+        a->values == b->values && a->dimensions == b->dimensions);
+}
+
 bool valuesEqual(Value a, Value b) {
     if (a.type != b.type) return false;
     switch (a.type) {
         case VAL_BOOL:      return AS_BOOL(a) == AS_BOOL(b);
         case VAL_NULL:      return true;
         case VAL_NUMBER:    return AS_NUMBER(a) == AS_NUMBER(b);
-        case VAL_OBJ:       return AS_OBJ(a) == AS_OBJ(b);
+        case VAL_OBJ:
+            if (IS_GRID(a) && IS_GRID(b)) {
+                return gridsEqual(AS_GRID(a), AS_GRID(b));
+            }
+            return AS_OBJ(a) == AS_OBJ(b);
         default:            return false; // Unreachable.
     }
 }
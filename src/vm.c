@@ -4,6 +4,14 @@
 #include <time.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 
 #include "common.h"
 #include "vm.h"
@@ -12,126 +20,1655 @@
 #include "compiler.h"
 #include "debug.h"
 
-VM vm;
+VM vm;
+
+static void resetStack() {
+    vm.stackTop = vm.stack;
+    vm.frameCount = 0;
+    vm.openUpvalues = NULL;
+}
+
+static void runtimeError(const char* format, ...) {
+    // Whatever was printed before the error should come before it.
+    flushOutput();
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputs("\n", stderr);
+
+    for (int i = vm.frameCount - 1; i >= 0; i--) {
+        CallFrame* frame = &vm.frames[i];
+        ObjFunction* function = frame->closure->function;
+        size_t instruction = frame->ip - function->chunk.code - 1;
+        int line = getLine(&function->chunk, instruction);
+
+        // An inlined body reports the call it stands for.
+        InlinedCall* inlined = findInlinedCall(&function->chunk,
+                                               (int)instruction);
+        if (inlined != NULL) {
+            fprintf(stderr, "[linya %d] sa %s()\n", line,
+                    inlined->name->chars);
+            line = inlined->line;
+        }
+
+        fprintf(stderr, "[linya %d] sa ", line);
+        if (function->name == NULL) {
+            fprintf(stderr, "skrip\n");
+        } else {
+            fprintf(stderr, "%s()\n", function->name->chars);
+        }
+    }
+
+    resetStack();
+}
+
+static bool isSameArity(int argCount, int funcArity) {
+    if (argCount != funcArity) {
+        runtimeError("Inaasahan na makakita ng %d argumento ngunit nakakita ng %d.",
+            funcArity, argCount);
+        return false;
+    }
+
+    return true;
+}
+
+static bool willNotOverflow() {
+    if (vm.frameCount == FRAMES_MAX) {
+        runtimeError("Umaapaw ang salansan.");
+        return false;
+    }
+
+    return true;
+}
+
+// Negative positions count from the end like with '[]'. The position
+// right after the last element is only valid when isEnd is set. Written
+// so that NaN fails the comparison too.
+static bool arrayPosition(int count, Value index, bool isEnd,
+                          int* position) {
+    if (!IS_NUMBER(index)) return false;
+
+    double value = AS_NUMBER(index);
+    if (!(value < count + (isEnd ? 1 : 0) && value > -count - 1)) return false;
+
+    *position = (int)value;
+    if (*position < 0) *position += count;
+    return true;
+}
+
+// The error for a position arrayPosition can't take, or NULL.
+static const char* positionError(int count, Value index, bool isEnd,
+                                 int* position) {
+    if (!IS_NUMBER(index)) {
+        return "Inaasahan na makatanggap ng numero bilang indeks.";
+    }
+    if (!arrayPosition(count, index, isEnd, position)) {
+        return "Lampas sa hangganan ang indeks.";
+    }
+    return NULL;
+}
+
+// Reports an argument a native can't take. The null it returns is
+// ignored, like any return value after an error.
+static Value argumentError(const char* message) {
+    runtimeError("%s", message);
+    return NULL_VAL;
+}
+
+// Single characters are handed out from a cache, so indexing a string or
+// going through it doesn't look them up or allocate them again.
+static ObjString* charString(char c) {
+    uint8_t index = (uint8_t)c;
+    if (vm.charStrings[index] == NULL) {
+        vm.charStrings[index] = copyString(&c, 1);
+    }
+    return vm.charStrings[index];
+}
+
+// Natives are only called with as many arguments as their arity, the
+// caller checks it. One with a check is only called once the check has
+// passed, so it doesn't look at its arguments again.
+static const char* checkStringLength(int argCount, Value* args) {
+    if (!IS_STRING(args[0])) {
+        return "Inaasahan na makatanggap ng salita ang sukatSalita().";
+    }
+    return NULL;
+}
+
+static Value stringLengthNative(int argCount, Value* args) {
+    return NUMBER_VAL(AS_STRING(args[0])->length);
+}
+
+static const char* checkCharToInt(int argCount, Value* args) {
+    if (!IS_STRING(args[0])) {
+        return "Inaasahan na makatanggap ng salita ang bilangNumero().";
+    }
+
+    ObjString* string = AS_STRING(args[0]);
+    int position;
+    if (argCount == 2) {
+        return positionError(string->length, args[1], false, &position);
+    }
+    if (string->length != 1) {
+        return "Inaasahan na makatanggap ng salita na may isang titik ang bilangNumero().";
+    }
+    return NULL;
+}
+
+// The code of a one character string, or of the character at an index.
+static Value charToIntNative(int argCount, Value* args) {
+    ObjString* string = AS_STRING(args[0]);
+    int position = 0;
+    if (argCount == 2) arrayPosition(string->length, args[1], false, &position);
+
+    return NUMBER_VAL((uint8_t)string->chars[position]);
+}
+
+// Where needle first appears in haystack from start, or -1. memchr finds
+// the candidates for its first character.
+static int findString(ObjString* haystack, ObjString* needle, int start) {
+    if (needle->length == 0) return start;
+
+    const char* chars = haystack->chars;
+    const char* last = chars + haystack->length - needle->length;
+    const char* candidate = chars + start;
+    while (candidate <= last) {
+        candidate = memchr(candidate, needle->chars[0], last - candidate + 1);
+        if (candidate == NULL) return -1;
+        if (memcmp(candidate, needle->chars, needle->length) == 0) {
+            return (int)(candidate - chars);
+        }
+        candidate++;
+    }
+    return -1;
+}
+
+static Value splitNative(int argCount, Value* args) {
+    if (!IS_STRING(args[0]) || !IS_STRING(args[1])) {
+        return argumentError("Inaasahan na makatanggap ng dalawang salita ang hatiin().");
+    }
+
+    ObjString* string = AS_STRING(args[0]);
+    ObjString* separator = AS_STRING(args[1]);
+    ObjArray* array = newArray();
+    push(OBJ_VAL(array));
+
+    if (separator->length == 0) {
+        // Without a separator every character is its own part.
+        for (int i = 0; i < string->length; i++) {
+            writeValueArray(&array->elements,
+                            OBJ_VAL(charString(string->chars[i])));
+        }
+    } else {
+        int start = 0;
+        for (;;) {
+            int end = findString(string, separator, start);
+            if (end == -1) end = string->length;
+
+            Value part = OBJ_VAL(copyString(string->chars + start,
+                                            end - start));
+            push(part);
+            writeValueArray(&array->elements, part);
+            pop();
+
+            if (end == string->length) break;
+            start = end + separator->length;
+        }
+    }
+
+    pop();
+    return OBJ_VAL(array);
+}
+
+static const char* checkStartsWith(int argCount, Value* args) {
+    if (!IS_STRING(args[0]) || !IS_STRING(args[1])) {
+        return "Inaasahan na makatanggap ng dalawang salita ang nagsisimulaSa().";
+    }
+    return NULL;
+}
+
+static Value startsWithNative(int argCount, Value* args) {
+    ObjString* string = AS_STRING(args[0]);
+    ObjString* prefix = AS_STRING(args[1]);
+    return BOOL_VAL(prefix->length <= string->length &&
+        memcmp(string->chars, prefix->chars, prefix->length) == 0);
+}
+
+static const char* checkEndsWith(int argCount, Value* args) {
+    if (!IS_STRING(args[0]) || !IS_STRING(args[1])) {
+        return "Inaasahan na makatanggap ng dalawang salita ang nagtataposSa().";
+    }
+    return NULL;
+}
+
+static Value endsWithNative(int argCount, Value* args) {
+    ObjString* string = AS_STRING(args[0]);
+    ObjString* suffix = AS_STRING(args[1]);
+    return BOOL_VAL(suffix->length <= string->length &&
+        memcmp(string->chars + string->length - suffix->length,
+               suffix->chars, suffix->length) == 0);
+}
+
+static const char* checkCompare(int argCount, Value* args) {
+    if (!IS_STRING(args[0]) || !IS_STRING(args[1])) {
+        return "Inaasahan na makatanggap ng dalawang salita ang ihambing().";
+    }
+    return NULL;
+}
+
+static Value compareNative(int argCount, Value* args) {
+    ObjString* left = AS_STRING(args[0]);
+    ObjString* right = AS_STRING(args[1]);
+    int length = left->length < right->length ? left->length : right->length;
+    int result = memcmp(left->chars, right->chars, length);
+    if (result == 0) result = left->length - right->length;
+    return NUMBER_VAL(result < 0 ? -1 : result > 0 ? 1 : 0);
+}
+
+// The character codes of a string, so text can be worked on as numbers.
+static Value bytesNative(int argCount, Value* args) {
+    if (!IS_STRING(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng salita ang mgaBilangNumero().");
+    }
+
+    ObjString* string = AS_STRING(args[0]);
+    ObjArray* array = newArray();
+    if (string->length > 0) {
+        push(OBJ_VAL(array));
+        ValueArray* elements = &array->elements;
+        elements->values = GROW_ARRAY(Value, NULL, 0, string->length);
+        for (int i = 0; i < string->length; i++) {
+            elements->values[i] = NUMBER_VAL((uint8_t)string->chars[i]);
+        }
+        elements->capacity = string->length;
+        elements->count = string->length;
+        pop();
+    }
+    return OBJ_VAL(array);
+}
+
+static Value hasFieldNative(int argCount, Value* args) {
+    if (!(IS_INSTANCE(args[0]) && IS_STRING(args[1]))) {
+        return argumentError("Inaasahan na makatanggap ng instansya at salita ang mayKatangian().");
+    }
+
+    ObjInstance* instance = AS_INSTANCE(args[0]);
+    Value dummy;
+    return BOOL_VAL(tableGet(&instance->fields, AS_STRING(args[1]), &dummy));
+}
+
+static Value scanNative(int argCount, Value* args) {
+
+    // The prompt may still be in the buffer.
+    flushOutput();
+
+    char input[1024];
+    if (!fgets(input, sizeof(input), stdin)) {
+        writeOutput("Hindi mabasa ang ibinigay na halaga.\n");
+        return NULL_VAL;
+    }
+
+    // fgets read the '\n' at the end that serves as the +1 for '\0'.
+    int length = strlen(input);
+
+    int i = 0;
+    while (input[i] != '\0' && isdigit(input[i]))
+        i++;
+
+    if (i != length && input[i] == '.')
+        while (input[i] != '\0' && isdigit(input[i]))
+            i++;
+
+    input[length - 1] = '\0'; // Replace '\n' with '\0'.
+    if (i == length - 1)
+        return NUMBER_VAL(strtod(input, NULL));
+    else 
+        return OBJ_VAL(copyString(input, length));
+}
+
+static Value rangeNative(int argCount, Value* args) {
+    if (!(IS_NUMBER(args[0]) && IS_NUMBER(args[1]))) {
+        return argumentError("Inaasahan na makatanggap ng dalawang numero ang saklaw().");
+    }
+
+    return OBJ_VAL(newRange(AS_NUMBER(args[0]), AS_NUMBER(args[1])));
+}
+
+// The elements of source from start up to but not including end.
+static Value sliceArray(ObjArray* source, int start, int end) {
+    ObjArray* array = newArray();
+    push(OBJ_VAL(array));
+
+    int count = end - start;
+    if (count > 0) {
+        ValueArray* elements = &array->elements;
+        elements->values = GROW_ARRAY(Value, NULL, 0, count);
+        memcpy(elements->values, source->elements.values + start,
+               count * sizeof(Value));
+        elements->capacity = count;
+        elements->count = count;
+    }
+
+    pop();
+    return OBJ_VAL(array);
+}
+
+// A key can be anything but null and NaN, which could never be found
+// again.
+static bool checkKey(Value key) {
+    if (IS_NULL(key) || (IS_NUMBER(key) && AS_NUMBER(key) != AS_NUMBER(key))) {
+        runtimeError("Hindi maaaring gamitin ang null o NaN bilang susi.");
+        return false;
+    }
+    return true;
+}
+
+static bool setAdd(ObjSet* set, Value value) {
+    if (!checkKey(value)) return false;
+
+    if (valueTableSet(&set->table, value, BOOL_VAL(true))) set->count++;
+    return true;
+}
+
+// Makes room for one more element in the ring buffer, moving the elements
+// to the start of the new one.
+static void growDeque(ObjDeque* deque) {
+    if (deque->count < deque->capacity) return;
+
+    int capacity = GROW_CAPACITY(deque->capacity);
+    Value* values = ALLOCATE(Value, capacity);
+    for (int i = 0; i < deque->count; i++) {
+        values[i] = deque->values[(deque->head + i) % deque->capacity];
+    }
+    FREE_ARRAY(Value, deque->values, deque->capacity);
+
+    deque->values = values;
+    deque->capacity = capacity;
+    deque->head = 0;
+}
+
+static void dequePushBack(ObjDeque* deque, Value value) {
+    growDeque(deque);
+    deque->values[(deque->head + deque->count) % deque->capacity] = value;
+    deque->count++;
+}
+
+static const char* checkLength(int argCount, Value* args) {
+    Value value = args[0];
+    if (IS_ARRAY(value) || IS_GRID(value) || IS_STRING(value) ||
+        IS_MAP(value) || IS_SET(value) || IS_DEQUE(value) ||
+        IS_HEAP(value) || IS_STRING_BUILDER(value)) {
+        return NULL;
+    }
+    return "Walang haba ang halagang ibinigay sa haba().";
+}
+
+static Value lengthNative(int argCount, Value* args) {
+    if (IS_GRID(args[0])) return NUMBER_VAL(AS_GRID(args[0])->sizes[0]);
+    if (IS_STRING(args[0])) return NUMBER_VAL(AS_STRING(args[0])->length);
+    if (IS_MAP(args[0])) return NUMBER_VAL(AS_MAP(args[0])->count);
+    if (IS_SET(args[0])) return NUMBER_VAL(AS_SET(args[0])->count);
+    if (IS_DEQUE(args[0])) return NUMBER_VAL(AS_DEQUE(args[0])->count);
+    if (IS_HEAP(args[0])) return NUMBER_VAL(AS_HEAP(args[0])->elements.count);
+    if (IS_STRING_BUILDER(args[0])) {
+        return NUMBER_VAL(AS_STRING_BUILDER(args[0])->length);
+    }
+
+    return NUMBER_VAL(AS_ARRAY(args[0])->elements.count);
+}
+
+// Makes room for count more chars at the end of the builder.
+static bool reserveChars(ObjStringBuilder* builder, int count) {
+    if (count > INT_MAX - builder->length) {
+        runtimeError("Masyadong mahaba ang salita.");
+        return false;
+    }
+
+    int needed = builder->length + count;
+    if (needed <= builder->capacity) return true;
+
+    int capacity = builder->capacity < 8 ? 8 : builder->capacity;
+    while (capacity < needed) {
+        capacity = capacity > INT_MAX / 2 ? needed : capacity * 2;
+    }
+    builder->chars = GROW_ARRAY(char, builder->chars, builder->capacity,
+                                capacity);
+    builder->capacity = capacity;
+    return true;
+}
+
+static bool appendChars(ObjStringBuilder* builder, const char* chars,
+                        int length) {
+    if (!reserveChars(builder, length)) return false;
+
+    memcpy(builder->chars + builder->length, chars, length);
+    builder->length += length;
+    return true;
+}
+
+// Appends the value the way '+' would turn it into a string. Numbers are
+// formatted straight into the builder.
+static bool appendValue(ObjStringBuilder* builder, Value value) {
+    switch (value.type) {
+        case VAL_BOOL:
+            return appendChars(builder, AS_BOOL(value) ? "tama" : "mali", 4);
+        case VAL_NULL:
+            return appendChars(builder, "null", 4);
+        case VAL_NUMBER: {
+            // One more for the terminator snprintf writes.
+            if (!reserveChars(builder, VAL_BUFFER_SIZE + 1)) return false;
+
+            builder->length += snprintf(builder->chars + builder->length,
+                VAL_BUFFER_SIZE + 1, "%g", AS_NUMBER(value));
+            return true;
+        }
+        case VAL_OBJ:
+            if (IS_STRING(value)) {
+                return appendChars(builder, AS_CSTRING(value),
+                                   AS_STRING(value)->length);
+            }
+
+            if (IS_STRING_BUILDER(value)) {
+                // The source may be the builder itself, so its chars are
+                // only read after they have room to be copied to.
+                ObjStringBuilder* source = AS_STRING_BUILDER(value);
+                int length = source->length;
+                if (!reserveChars(builder, length)) return false;
+
+                memcpy(builder->chars + builder->length, source->chars,
+                       length);
+                builder->length += length;
+                return true;
+            }
+
+            runtimeError("Ang halaga ay hindi magawang salita.");
+            return false;
+    }
+    return false;
+}
+
+static bool heapPush(ObjHeap* heap, Value value);
+static bool heapPop(ObjHeap* heap, Value* top);
+
+static Value pushNative(int argCount, Value* args) {
+    if (IS_STRING_BUILDER(args[0])) {
+        ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+        if (!appendValue(builder, args[1])) return NULL_VAL;
+        return NUMBER_VAL(builder->length);
+    }
+
+    if (IS_SET(args[0])) {
+        ObjSet* set = AS_SET(args[0]);
+        if (!setAdd(set, args[1])) return NULL_VAL;
+        return NUMBER_VAL(set->count);
+    }
+
+    if (IS_DEQUE(args[0])) {
+        ObjDeque* deque = AS_DEQUE(args[0]);
+        dequePushBack(deque, args[1]);
+        return NUMBER_VAL(deque->count);
+    }
+
+    if (IS_HEAP(args[0])) {
+        ObjHeap* heap = AS_HEAP(args[0]);
+        if (!heapPush(heap, args[1])) return NULL_VAL;
+        return NUMBER_VAL(heap->elements.count);
+    }
+
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon, kalipunan, pila, tambak o tagabuo ang idagdag().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    writeValueArray(elements, args[1]);
+    return NUMBER_VAL(elements->count);
+}
+
+static Value popNative(int argCount, Value* args) {
+    if (IS_DEQUE(args[0])) {
+        ObjDeque* deque = AS_DEQUE(args[0]);
+        if (deque->count == 0) {
+            return argumentError("Walang laman ang pila na ibinigay sa tanggalin().");
+        }
+
+        deque->count--;
+        return deque->values[(deque->head + deque->count) % deque->capacity];
+    }
+
+    if (IS_HEAP(args[0])) {
+        if (AS_HEAP(args[0])->elements.count == 0) {
+            return argumentError("Walang laman ang tambak na ibinigay sa tanggalin().");
+        }
+
+        Value top;
+        return heapPop(AS_HEAP(args[0]), &top) ? top : NULL_VAL;
+    }
+
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon, pila o tambak ang tanggalin().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    if (elements->count == 0) {
+        return argumentError("Walang laman ang koleksyon na ibinigay sa tanggalin().");
+    }
+
+    return elements->values[--elements->count];
+}
+
+static Value insertNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang isingit().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    int position;
+    const char* error = positionError(elements->count, args[1], true,
+                                      &position);
+    if (error != NULL) return argumentError(error);
+
+    // Grows the array if needed, then makes room at the position.
+    writeValueArray(elements, args[2]);
+    memmove(&elements->values[position + 1], &elements->values[position],
+            (elements->count - 1 - position) * sizeof(Value));
+    elements->values[position] = args[2];
+    return NUMBER_VAL(elements->count);
+}
+
+static Value removeNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang alisin().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    int position;
+    const char* error = positionError(elements->count, args[1], false,
+                                      &position);
+    if (error != NULL) return argumentError(error);
+
+    Value removed = elements->values[position];
+    elements->count--;
+    memmove(&elements->values[position], &elements->values[position + 1],
+            (elements->count - position) * sizeof(Value));
+    return removed;
+}
+
+static const char* checkSlice(int argCount, Value* args) {
+    int count;
+    if (IS_STRING(args[0])) {
+        count = AS_STRING(args[0])->length;
+    } else if (IS_ARRAY(args[0])) {
+        count = AS_ARRAY(args[0])->elements.count;
+    } else {
+        return "Inaasahan na makatanggap ng koleksyon o salita ang hiwain().";
+    }
+
+    int position;
+    const char* error = positionError(count, args[1], true, &position);
+    if (error == NULL) error = positionError(count, args[2], true, &position);
+    return error;
+}
+
+static Value sliceNative(int argCount, Value* args) {
+    if (IS_STRING(args[0])) {
+        ObjString* string = AS_STRING(args[0]);
+        int start;
+        int end;
+        arrayPosition(string->length, args[1], true, &start);
+        arrayPosition(string->length, args[2], true, &end);
+
+        if (end - start == 1) return OBJ_VAL(charString(string->chars[start]));
+        return OBJ_VAL(copyString(string->chars + start,
+                                  end > start ? end - start : 0));
+    }
+
+    ObjArray* array = AS_ARRAY(args[0]);
+    int start;
+    int end;
+    arrayPosition(array->elements.count, args[1], true, &start);
+    arrayPosition(array->elements.count, args[2], true, &end);
+
+    return sliceArray(array, start, end);
+}
+
+static Value fillNative(int argCount, Value* args) {
+    if (IS_GRID(args[0])) {
+        ObjGrid* grid = AS_GRID(args[0]);
+        int count = grid->sizes[0] * grid->strides[0];
+        for (int i = 0; i < count; i++) {
+            grid->values[i] = args[1];
+        }
+        return args[0];
+    }
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang punuin().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    for (int i = 0; i < elements->count; i++) {
+        elements->values[i] = args[1];
+    }
+    return args[0];
+}
+
+static Value reverseNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang baligtarin().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    for (int i = 0, j = elements->count - 1; i < j; i++, j--) {
+        Value swap = elements->values[i];
+        elements->values[i] = elements->values[j];
+        elements->values[j] = swap;
+    }
+    return args[0];
+}
+
+static const char* checkIndexOf(int argCount, Value* args) {
+    if (IS_STRING(args[0])) {
+        if (!IS_STRING(args[1])) {
+            return "Salita lamang ang maaaring hanapin sa salita.";
+        }
+
+        int start;
+        if (argCount == 3) {
+            return positionError(AS_STRING(args[0])->length, args[2], true,
+                                 &start);
+        }
+        return NULL;
+    }
+
+    if (!IS_ARRAY(args[0])) {
+        return "Inaasahan na makatanggap ng koleksyon o salita ang hanapin().";
+    }
+    if (argCount == 3) {
+        return "Sa salita lamang maaaring bigyan ng simula ang hanapin().";
+    }
+    return NULL;
+}
+
+static Value indexOfNative(int argCount, Value* args) {
+    if (IS_STRING(args[0])) {
+        ObjString* string = AS_STRING(args[0]);
+        int start = 0;
+        if (argCount == 3) arrayPosition(string->length, args[2], true, &start);
+        return NUMBER_VAL(findString(string, AS_STRING(args[1]), start));
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    for (int i = 0; i < elements->count; i++) {
+        if (valuesEqual(elements->values[i], args[1])) return NUMBER_VAL(i);
+    }
+    return NUMBER_VAL(-1);
+}
+
+static Value copyNative(int argCount, Value* args) {
+    if (IS_GRID(args[0])) {
+        ObjGrid* grid = AS_GRID(args[0]);
+        ObjGrid* copy = newGrid(grid->dimensions, grid->sizes);
+        memcpy(copy->values, grid->values,
+               grid->sizes[0] * grid->strides[0] * sizeof(Value));
+        return OBJ_VAL(copy);
+    }
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang kopyahin().");
+    }
+
+    ObjArray* array = AS_ARRAY(args[0]);
+    return sliceArray(array, 0, array->elements.count);
+}
+
+// The elements of a collection if all of them are numbers, for the fast
+// loops of the numeric natives below. Any other collection goes through
+// the slower loops that follow, one element at a time.
+static ValueArray* numberElements(Value value) {
+    if (!IS_ARRAY(value)) return NULL;
+
+    ValueArray* elements = &AS_ARRAY(value)->elements;
+    for (int i = 0; i < elements->count; i++) {
+        if (!IS_NUMBER(elements->values[i])) return NULL;
+    }
+    return elements;
+}
+
+static bool arithmetic(uint8_t operation);
+
+// Computes 'a <operation> b' like the instruction in a script would,
+// including its errors.
+static bool combine(Value a, Value b, uint8_t operation, Value* result) {
+    push(a);
+    push(b);
+    if (!arithmetic(operation)) return false;
+
+    *result = pop();
+    return true;
+}
+
+// Adds the elements, or their products with the elements of others as
+// long, in order like '+' would.
+static Value sumEach(ValueArray* elements, ValueArray* others) {
+    Value sum = NUMBER_VAL(0);
+    for (int i = 0; i < elements->count; i++) {
+        Value term = elements->values[i];
+        if (others != NULL &&
+            !combine(term, others->values[i], OP_MULTIPLY, &term)) {
+            return NULL_VAL;
+        }
+        if (i == 0) {
+            sum = term;
+        } else if (!combine(sum, term, OP_ADD, &sum)) {
+            return NULL_VAL;
+        }
+    }
+    return sum;
+}
+
+// Replaces each element with 'element <operation> operand', or with the
+// matching element of operands when it is given.
+static Value applyEach(Value collection, Value operand, ValueArray* operands,
+                       uint8_t operation) {
+    ValueArray* elements = &AS_ARRAY(collection)->elements;
+    for (int i = 0; i < elements->count; i++) {
+        Value b = operands != NULL ? operands->values[i] : operand;
+        if (!combine(elements->values[i], b, operation,
+                     &elements->values[i])) {
+            return NULL_VAL;
+        }
+    }
+    return collection;
+}
+
+// Sums are kept in four separate chains so consecutive additions don't
+// wait on each other. The order of the additions differs from a loop in
+// the script, so the last digits may too.
+static Value sumNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang kabuuan().");
+    }
+
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) return sumEach(&AS_ARRAY(args[0])->elements, NULL);
+
+    Value* values = elements->values;
+    double sums[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= elements->count; i += 4) {
+        sums[0] += AS_NUMBER(values[i]);
+        sums[1] += AS_NUMBER(values[i + 1]);
+        sums[2] += AS_NUMBER(values[i + 2]);
+        sums[3] += AS_NUMBER(values[i + 3]);
+    }
+    for (; i < elements->count; i++) sums[0] += AS_NUMBER(values[i]);
+
+    return NUMBER_VAL((sums[0] + sums[1]) + (sums[2] + sums[3]));
+}
+
+static Value dotNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0]) || !IS_ARRAY(args[1])) {
+        return argumentError("Inaasahan na makatanggap ng dalawang koleksyon ang tuldokProdukto().");
+    }
+    if (AS_ARRAY(args[0])->elements.count !=
+        AS_ARRAY(args[1])->elements.count) {
+        return argumentError("Magkaiba ang haba ng mga koleksyon na ibinigay sa tuldokProdukto().");
+    }
+
+    ValueArray* a = numberElements(args[0]);
+    ValueArray* b = numberElements(args[1]);
+    if (a == NULL || b == NULL) {
+        return sumEach(&AS_ARRAY(args[0])->elements,
+                       &AS_ARRAY(args[1])->elements);
+    }
+
+    double sums[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= a->count; i += 4) {
+        sums[0] += AS_NUMBER(a->values[i]) * AS_NUMBER(b->values[i]);
+        sums[1] += AS_NUMBER(a->values[i + 1]) * AS_NUMBER(b->values[i + 1]);
+        sums[2] += AS_NUMBER(a->values[i + 2]) * AS_NUMBER(b->values[i + 2]);
+        sums[3] += AS_NUMBER(a->values[i + 3]) * AS_NUMBER(b->values[i + 3]);
+    }
+    for (; i < a->count; i++) {
+        sums[0] += AS_NUMBER(a->values[i]) * AS_NUMBER(b->values[i]);
+    }
+
+    return NUMBER_VAL((sums[0] + sums[1]) + (sums[2] + sums[3]));
+}
+
+// Only numbers can be compared with '<', so a collection with anything
+// else fails the same way.
+static Value compareEach(Value collection, const char* name) {
+    if (IS_ARRAY(collection)) {
+        runtimeError("Inaasahang parehong numero ang gamit.");
+    } else {
+        runtimeError("Inaasahan na makatanggap ng koleksyon ang %s().", name);
+    }
+    return NULL_VAL;
+}
+
+// Index of the smallest (or largest) number, the first one if repeated.
+static int extremeIndex(ValueArray* elements, bool isMax) {
+    if (elements->count == 0) return -1;
+
+    int index = 0;
+    double extreme = AS_NUMBER(elements->values[0]);
+    for (int i = 1; i < elements->count; i++) {
+        double value = AS_NUMBER(elements->values[i]);
+        if (isMax ? value > extreme : value < extreme) {
+            extreme = value;
+            index = i;
+        }
+    }
+    return index;
+}
+
+static Value minNative(int argCount, Value* args) {
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) return compareEach(args[0], "pinakamaliit");
+    if (elements->count == 0) {
+        return argumentError("Walang laman ang koleksyon na ibinigay sa pinakamaliit().");
+    }
+
+    return elements->values[extremeIndex(elements, false)];
+}
+
+static Value maxNative(int argCount, Value* args) {
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) return compareEach(args[0], "pinakamalaki");
+    if (elements->count == 0) {
+        return argumentError("Walang laman ang koleksyon na ibinigay sa pinakamalaki().");
+    }
+
+    return elements->values[extremeIndex(elements, true)];
+}
+
+static Value minIndexNative(int argCount, Value* args) {
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) {
+        return compareEach(args[0], "indeksNgPinakamaliit");
+    }
+
+    return NUMBER_VAL(extremeIndex(elements, false));
+}
+
+static Value scaleNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang paramihin().");
+    }
+
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL || !IS_NUMBER(args[1])) {
+        return applyEach(args[0], args[1], NULL, OP_MULTIPLY);
+    }
+
+    double factor = AS_NUMBER(args[1]);
+    for (int i = 0; i < elements->count; i++) {
+        double value = AS_NUMBER(elements->values[i]);
+        elements->values[i] = NUMBER_VAL(value * factor);
+    }
+    return args[0];
+}
+
+// Adds a number, or the elements of a collection as long, to each element.
+static Value addNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang dagdagan().");
+    }
+
+    ValueArray* operands = NULL;
+    if (IS_ARRAY(args[1])) {
+        operands = &AS_ARRAY(args[1])->elements;
+        if (operands->count != AS_ARRAY(args[0])->elements.count) {
+            return argumentError("Magkaiba ang haba ng mga koleksyon na ibinigay sa dagdagan().");
+        }
+    }
+
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) return applyEach(args[0], args[1], operands, OP_ADD);
+
+    if (IS_NUMBER(args[1])) {
+        double addend = AS_NUMBER(args[1]);
+        for (int i = 0; i < elements->count; i++) {
+            double value = AS_NUMBER(elements->values[i]);
+            elements->values[i] = NUMBER_VAL(value + addend);
+        }
+        return args[0];
+    }
+
+    ValueArray* addends = numberElements(args[1]);
+    if (addends == NULL) return applyEach(args[0], args[1], operands, OP_ADD);
+
+    for (int i = 0; i < elements->count; i++) {
+        elements->values[i] = NUMBER_VAL(AS_NUMBER(elements->values[i]) +
+                                         AS_NUMBER(addends->values[i]));
+    }
+    return args[0];
+}
+
+// Replaces each element with the sum of the elements up to it.
+static Value prefixSumNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang ipunin().");
+    }
+
+    ValueArray* elements = numberElements(args[0]);
+    if (elements == NULL) {
+        elements = &AS_ARRAY(args[0])->elements;
+        for (int i = 1; i < elements->count; i++) {
+            if (!combine(elements->values[i - 1], elements->values[i],
+                         OP_ADD, &elements->values[i])) {
+                return NULL_VAL;
+            }
+        }
+        return args[0];
+    }
+
+    double sum = 0;
+    for (int i = 0; i < elements->count; i++) {
+        sum += AS_NUMBER(elements->values[i]);
+        elements->values[i] = NUMBER_VAL(sum);
+    }
+    return args[0];
+}
+
+// Counts the elements equal to a value. Unlike the others it takes any
+// collection, and only numbers are compared without valuesEqual.
+static Value countNative(int argCount, Value* args) {
+    if (!IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang bilangin().");
+    }
+
+    ValueArray* elements = &AS_ARRAY(args[0])->elements;
+    int count = 0;
+    if (IS_NUMBER(args[1])) {
+        double number = AS_NUMBER(args[1]);
+        for (int i = 0; i < elements->count; i++) {
+            Value value = elements->values[i];
+            count += IS_NUMBER(value) && AS_NUMBER(value) == number;
+        }
+    } else {
+        for (int i = 0; i < elements->count; i++) {
+            count += valuesEqual(elements->values[i], args[1]);
+        }
+    }
+    return NUMBER_VAL(count);
+}
+
+// The keys or the values of a diksyunaryo in a new collection.
+static Value mapEntries(ObjMap* map, bool isKeys) {
+    ObjArray* array = newArray();
+    push(OBJ_VAL(array));
+
+    for (int i = 0; i < map->table.capacity; i++) {
+        ValueEntry* entry = &map->table.entries[i];
+        if (IS_NULL(entry->key)) continue;
+
+        writeValueArray(&array->elements, isKeys ? entry->key : entry->value);
+    }
+
+    pop();
+    return OBJ_VAL(array);
+}
+
+static Value keysNative(int argCount, Value* args) {
+    if (!IS_MAP(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng diksyunaryo ang mgaSusi().");
+    }
+
+    return mapEntries(AS_MAP(args[0]), true);
+}
+
+static Value valuesNative(int argCount, Value* args) {
+    if (!IS_MAP(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng diksyunaryo ang mgaHalaga().");
+    }
+
+    return mapEntries(AS_MAP(args[0]), false);
+}
+
+static Value hasKeyNative(int argCount, Value* args) {
+    Value value;
+    if (IS_SET(args[0])) {
+        return BOOL_VAL(valueTableGet(&AS_SET(args[0])->table, args[1], &value));
+    }
+    if (!IS_MAP(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng diksyunaryo o kalipunan ang maySusi().");
+    }
+
+    return BOOL_VAL(valueTableGet(&AS_MAP(args[0])->table, args[1], &value));
+}
+
+static Value deleteNative(int argCount, Value* args) {
+    if (IS_SET(args[0])) {
+        ObjSet* set = AS_SET(args[0]);
+        if (!valueTableDelete(&set->table, args[1])) return BOOL_VAL(false);
+
+        set->count--;
+        return BOOL_VAL(true);
+    }
+    if (!IS_MAP(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng diksyunaryo o kalipunan ang burahin().");
+    }
+
+    ObjMap* map = AS_MAP(args[0]);
+    if (!valueTableDelete(&map->table, args[1])) return BOOL_VAL(false);
+
+    map->count--;
+    return BOOL_VAL(true);
+}
+
+static bool callFunction(Value callee, int argCount);
+
+typedef struct Sort {
+    int (*compare)(struct Sort* sort, Value a, Value b);
+    Value comparator;
+    bool failed;        // The comparator raised an error.
+} Sort;
+
+static int compareNumbers(Sort* sort, Value a, Value b) {
+    double left = AS_NUMBER(a);
+    double right = AS_NUMBER(b);
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static int compareStrings(Sort* sort, Value a, Value b) {
+    ObjString* left = AS_STRING(a);
+    ObjString* right = AS_STRING(b);
+    int length = left->length < right->length ? left->length : right->length;
+    int result = memcmp(left->chars, right->chars, length);
+    return result != 0 ? result : left->length - right->length;
+}
+
+static int compareWithFunction(Sort* sort, Value a, Value b) {
+    if (sort->failed) return 0;
+
+    push(sort->comparator);
+    push(a);
+    push(b);
+    if (!callFunction(sort->comparator, 2)) {
+        sort->failed = true;
+        return 0;
+    }
+
+    Value result = pop();
+    if (!IS_NUMBER(result)) {
+        runtimeError("Inaasahan na makatanggap ng numero mula sa gawaing panghambing.");
+        sort->failed = true;
+        return 0;
+    }
+
+    double order = AS_NUMBER(result);
+    return order < 0 ? -1 : order > 0 ? 1 : 0;
+}
+
+static void insertionSort(Sort* sort, Value* values, int lo, int hi) {
+    for (int i = lo + 1; i < hi; i++) {
+        Value value = values[i];
+        int j = i;
+        while (j > lo && sort->compare(sort, value, values[j - 1]) < 0) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = value;
+    }
+}
+
+static void siftDown(Sort* sort, Value* values, int root, int count) {
+    Value value = values[root];
+    for (int child = root * 2 + 1; child < count; child = root * 2 + 1) {
+        if (child + 1 < count &&
+            sort->compare(sort, values[child], values[child + 1]) < 0) {
+            child++;
+        }
+        if (sort->compare(sort, value, values[child]) >= 0) break;
+
+        values[root] = values[child];
+        root = child;
+    }
+    values[root] = value;
+}
+
+static void heapSort(Sort* sort, Value* values, int count) {
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        siftDown(sort, values, i, count);
+    }
+
+    for (int end = count - 1; end > 0; end--) {
+        Value largest = values[0];
+        values[0] = values[end];
+        values[end] = largest;
+        siftDown(sort, values, 0, end);
+    }
+}
+
+// Quicksort that switches to heapsort past depth levels of partitioning.
+// The partition loops stay in bounds even if the comparator is not
+// consistent.
+static void introSort(Sort* sort, Value* values, int lo, int hi, int depth) {
+    while (hi - lo > SORT_INSERTION_MAX) {
+        if (depth-- == 0) {
+            heapSort(sort, values + lo, hi - lo);
+            return;
+        }
+
+        // Median of the first, middle and last elements.
+        Value a = values[lo];
+        Value b = values[lo + (hi - lo) / 2];
+        Value c = values[hi - 1];
+        Value pivot;
+        if (sort->compare(sort, a, b) < 0) {
+            pivot = sort->compare(sort, b, c) < 0 ? b :
+                    sort->compare(sort, a, c) < 0 ? c : a;
+        } else {
+            pivot = sort->compare(sort, a, c) < 0 ? a :
+                    sort->compare(sort, b, c) < 0 ? c : b;
+        }
+
+        int i = lo;
+        int j = hi - 1;
+        while (i <= j) {
+            while (i < hi - 1 && sort->compare(sort, values[i], pivot) < 0) i++;
+            while (j > lo && sort->compare(sort, pivot, values[j]) < 0) j--;
+            if (i <= j) {
+                Value swap = values[i];
+                values[i++] = values[j];
+                values[j--] = swap;
+            }
+        }
+
+        // Recurses into the smaller part so the C stack stays shallow.
+        if (j + 1 - lo < hi - i) {
+            introSort(sort, values, lo, j + 1, depth);
+            lo = i;
+        } else {
+            introSort(sort, values, i, hi, depth);
+            hi = j + 1;
+        }
+    }
+
+    insertionSort(sort, values, lo, hi);
+}
+
+// Stable. Halves that are already in order are not merged, so sorted runs
+// cost one comparison each. The buffer holds at least hi elements.
+static void mergeSort(Sort* sort, Value* values, Value* buffer,
+                      int lo, int hi) {
+    if (hi - lo <= SORT_INSERTION_MAX) {
+        insertionSort(sort, values, lo, hi);
+        return;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    mergeSort(sort, values, buffer, lo, mid);
+    mergeSort(sort, values, buffer, mid, hi);
+    if (sort->compare(sort, values[mid - 1], values[mid]) <= 0) return;
+
+    memcpy(buffer + lo, values + lo, (mid - lo) * sizeof(Value));
+    int i = lo;
+    int j = mid;
+    int k = lo;
+    while (i < mid && j < hi) {
+        if (sort->compare(sort, values[j], buffer[i]) < 0) {
+            values[k++] = values[j++];
+        } else {
+            values[k++] = buffer[i++];
+        }
+    }
+    while (i < mid) values[k++] = buffer[i++];
+}
+
+static void sortValues(Sort* sort, Value* values, Value* buffer, int count) {
+    if (buffer != NULL) {
+        mergeSort(sort, values, buffer, 0, count);
+        return;
+    }
+
+    int depth = 0;
+    for (int n = count; n > 1; n >>= 1) depth += 2;
+    introSort(sort, values, 0, count, depth);
+}
+
+// Without a comparator only collections of all numbers or all strings
+// can be sorted, and they are compared directly.
+static bool naturalOrder(ValueArray* elements, Sort* sort) {
+    bool isNumbers = true;
+    bool isStrings = true;
+    for (int i = 0; i < elements->count; i++) {
+        if (!IS_NUMBER(elements->values[i])) isNumbers = false;
+        if (!IS_STRING(elements->values[i])) isStrings = false;
+    }
+
+    if (isNumbers) {
+        sort->compare = compareNumbers;
+    } else if (isStrings) {
+        sort->compare = compareStrings;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static Value sortArray(int argCount, Value* args, bool isStable) {
+    if (!IS_ARRAY(args[0])) {
+        runtimeError("Inaasahan na makatanggap ng koleksyon ang %s().",
+                     isStable ? "ayusinMatatag" : "ayusin");
+        return NULL_VAL;
+    }
+
+    ObjArray* array = AS_ARRAY(args[0]);
+    ValueArray* elements = &array->elements;
+    int count = elements->count;
+    Sort sort = {compareWithFunction, NULL_VAL, false};
+
+    if (argCount == 1) {
+        if (!naturalOrder(elements, &sort)) {
+            return argumentError("Tanging mga numero o mga salita lamang ang maaaring paghambingin nang walang gawaing panghambing.");
+        }
+
+        // Nothing is allocated while sorting, so the elements can be
+        // moved around in place.
+        Value* buffer = isStable ? ALLOCATE(Value, count) : NULL;
+        sortValues(&sort, elements->values, buffer, count);
+        if (isStable) FREE_ARRAY(Value, buffer, count);
+        return args[0];
+    }
+
+    // The comparator may allocate or even change the collection, so the
+    // elements are sorted in a copy. The copy and the buffer are kept on
+    // the stack since some elements are only in one of them while merging.
+    sort.comparator = args[1];
+    ObjArray* copy = AS_ARRAY(sliceArray(array, 0, count));
+    push(OBJ_VAL(copy));
+    ObjArray* buffer = NULL;
+    if (isStable) {
+        buffer = AS_ARRAY(sliceArray(array, 0, count));
+        push(OBJ_VAL(buffer));
+    }
+
+    sortValues(&sort, copy->elements.values,
+               isStable ? buffer->elements.values : NULL, count);
+    if (sort.failed) return NULL_VAL;
+
+    if (elements->count != count) {
+        runtimeError("Nagbago ang haba ng koleksyon habang ito ay inaayos.");
+        return NULL_VAL;
+    }
+
+    memcpy(elements->values, copy->elements.values, count * sizeof(Value));
+    if (isStable) pop();
+    pop();
+    return args[0];
+}
+
+static Value sortNative(int argCount, Value* args) {
+    return sortArray(argCount, args, false);
+}
+
+static Value stableSortNative(int argCount, Value* args) {
+    return sortArray(argCount, args, true);
+}
+
+// Without a comparator a tambak can hold numbers or strings, and unlike
+// in a sort they are only checked when they are compared.
+static int compareNatural(Sort* sort, Value a, Value b) {
+    if (sort->failed) return 0;
+
+    if (IS_NUMBER(a) && IS_NUMBER(b)) return compareNumbers(sort, a, b);
+    if (IS_STRING(a) && IS_STRING(b)) return compareStrings(sort, a, b);
+
+    runtimeError("Tanging mga numero o mga salita lamang ang maaaring paghambingin nang walang gawaing panghambing.");
+    sort->failed = true;
+    return 0;
+}
+
+// Compares heap elements i and j. The comparator is not allowed to add
+// to or take from the heap while it is being rearranged.
+static bool heapCompare(ObjHeap* heap, Sort* sort, int i, int j, int* order) {
+    int count = heap->elements.count;
+    *order = sort->compare(sort, heap->elements.values[i],
+                           heap->elements.values[j]);
+    if (sort->failed) return false;
+
+    if (heap->elements.count != count) {
+        runtimeError("Nagbago ang laman ng tambak habang ito ay inaayos.");
+        return false;
+    }
+    return true;
+}
+
+static void heapSwap(ObjHeap* heap, int i, int j) {
+    Value* values = heap->elements.values;
+    Value temp = values[i];
+    values[i] = values[j];
+    values[j] = temp;
+}
+
+static bool heapSiftUp(ObjHeap* heap, Sort* sort, int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        int order;
+        if (!heapCompare(heap, sort, index, parent, &order)) return false;
+        if (order >= 0) break;
+
+        heapSwap(heap, index, parent);
+        index = parent;
+    }
+    return true;
+}
+
+static bool heapSiftDown(ObjHeap* heap, Sort* sort, int index) {
+    int count = heap->elements.count;
+    for (;;) {
+        int first = index;
+        int left = index * 2 + 1;
+        int right = left + 1;
+        int order;
+        if (left < count) {
+            if (!heapCompare(heap, sort, left, first, &order)) return false;
+            if (order < 0) first = left;
+        }
+        if (right < count) {
+            if (!heapCompare(heap, sort, right, first, &order)) return false;
+            if (order < 0) first = right;
+        }
+        if (first == index) return true;
+
+        heapSwap(heap, index, first);
+        index = first;
+    }
+}
+
+static bool heapPush(ObjHeap* heap, Value value) {
+    Sort sort = {IS_NULL(heap->comparator) ? compareNatural :
+        compareWithFunction, heap->comparator, false};
 
-static void resetStack() {
-    vm.stackTop = vm.stack;
-    vm.frameCount = 0;
-    vm.openUpvalues = NULL;
+    writeValueArray(&heap->elements, value);
+    return heapSiftUp(heap, &sort, heap->elements.count - 1);
 }
 
-static void runtimeError(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    fputs("\n", stderr);
+// Takes the element that goes first. Returns false when the heap is
+// empty or its comparator failed.
+static bool heapPop(ObjHeap* heap, Value* top) {
+    ValueArray* elements = &heap->elements;
+    if (elements->count == 0) return false;
 
-    for (int i = vm.frameCount - 1; i >= 0; i--) {
-        CallFrame* frame = &vm.frames[i];
-        ObjFunction* function = frame->closure->function;
-        size_t instruction = frame->ip - function->chunk.code - 1;
-        fprintf(stderr, "[linya %d] sa ", 
-            getLine(&function->chunk, instruction));
-        if (function->name == NULL) {
-            fprintf(stderr, "skrip\n");
-        } else {
-            fprintf(stderr, "%s()\n", function->name->chars);
+    Sort sort = {IS_NULL(heap->comparator) ? compareNatural :
+        compareWithFunction, heap->comparator, false};
+
+    // Out of the heap it is only reachable from the stack.
+    *top = elements->values[0];
+    push(*top);
+    elements->values[0] = elements->values[--elements->count];
+    bool ok = heapSiftDown(heap, &sort, 0);
+    pop();
+    return ok;
+}
+
+static Value setNative(int argCount, Value* args) {
+    if (argCount == 1 && !IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang kalipunan().");
+    }
+
+    ObjSet* set = newSet();
+    push(OBJ_VAL(set));
+    if (argCount == 1) {
+        ValueArray* elements = &AS_ARRAY(args[0])->elements;
+        for (int i = 0; i < elements->count; i++) {
+            if (!setAdd(set, elements->values[i])) return NULL_VAL;
         }
     }
 
-    resetStack();
+    pop();
+    return OBJ_VAL(set);
 }
 
-static bool isSameArity(int argCount, int funcArity) {
-    if (argCount != funcArity) {
-        runtimeError("Inaasahan na makakita ng %d argumento ngunit nakakita ng %d.",
-            funcArity, argCount);
-        return false;
+static Value dequeNative(int argCount, Value* args) {
+    if (argCount == 1 && !IS_ARRAY(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng koleksyon ang pila().");
     }
 
-    return true;
+    ObjDeque* deque = newDeque();
+    push(OBJ_VAL(deque));
+    if (argCount == 1) {
+        ValueArray* elements = &AS_ARRAY(args[0])->elements;
+        for (int i = 0; i < elements->count; i++) {
+            dequePushBack(deque, elements->values[i]);
+        }
+    }
+
+    pop();
+    return OBJ_VAL(deque);
 }
 
-static bool willNotOverflow() {
-    if (vm.frameCount == FRAMES_MAX) {
-        runtimeError("Umaapaw ang salansan.");
-        return false;
+static Value heapNative(int argCount, Value* args) {
+    Value comparator = argCount == 1 ? args[0] : NULL_VAL;
+    if (!IS_NULL(comparator) && !IS_CLOSURE(comparator) &&
+        !IS_NATIVE(comparator) && !IS_BOUND_METHOD(comparator)) {
+        return argumentError("Inaasahan na makatanggap ng gawaing panghambing ang tambak().");
     }
 
-    return true;
+    return OBJ_VAL(newHeap(comparator));
 }
 
-static Value stringLengthNative(int argCount, Value* args) {
-    if (!(isSameArity(argCount, 1) && willNotOverflow()))
-        return BOOL_VAL(false);
-    if (!(IS_STRING(args[0])))
-        return BOOL_VAL(false);
-    
-    return NUMBER_VAL(strlen(AS_CSTRING(args[0])));
+static Value pushFrontNative(int argCount, Value* args) {
+    if (!IS_DEQUE(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng pila ang idagdagSaUna().");
+    }
+
+    ObjDeque* deque = AS_DEQUE(args[0]);
+    growDeque(deque);
+    deque->head = (deque->head + deque->capacity - 1) % deque->capacity;
+    deque->values[deque->head] = args[1];
+    deque->count++;
+    return NUMBER_VAL(deque->count);
 }
 
-static Value charToIntNative(int argCount, Value* args) {
-    if (!(isSameArity(argCount, 1) && willNotOverflow()))
-        return BOOL_VAL(false);
-    if (!(IS_STRING(args[0])))
-        return BOOL_VAL(false);
-    
-    int len = strlen(AS_CSTRING(args[0]));
-    if (len != 1) return NUMBER_VAL(-1);
+static Value popFrontNative(int argCount, Value* args) {
+    if (!IS_DEQUE(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng pila ang tanggalinSaUna().");
+    }
+
+    ObjDeque* deque = AS_DEQUE(args[0]);
+    if (deque->count == 0) {
+        return argumentError("Walang laman ang pila na ibinigay sa tanggalinSaUna().");
+    }
 
-    return NUMBER_VAL((int)AS_CSTRING(args[0])[0]);
+    Value front = deque->values[deque->head];
+    deque->head = (deque->head + 1) % deque->capacity;
+    deque->count--;
+    return front;
 }
 
-static Value hasFieldNative(int argCount, Value* args) {
-    if (!(isSameArity(argCount, 2) && willNotOverflow()))
-        return BOOL_VAL(false);
-    if (!(IS_INSTANCE(args[0]) && IS_STRING(args[1])))
-        return BOOL_VAL(false);
-    
-    ObjInstance* instance = AS_INSTANCE(args[0]);
-    Value dummy;
-    return BOOL_VAL(tableGet(&instance->fields, AS_STRING(args[1]), &dummy));
+static Value stringBuilderNative(int argCount, Value* args) {
+    ObjStringBuilder* builder = newStringBuilder();
+    if (argCount == 1) {
+        push(OBJ_VAL(builder));
+        if (!appendValue(builder, args[0])) return NULL_VAL;
+        pop();
+    }
+    return OBJ_VAL(builder);
 }
 
-static Value scanNative(int argCount, Value* args) {
-    if (!(isSameArity(argCount, 0) && willNotOverflow()))
-        return NULL_VAL;
+// Appends the value a number of times, copying the chars of the first
+// one for the rest.
+static Value repeatNative(int argCount, Value* args) {
+    if (!IS_STRING_BUILDER(args[0]) || !IS_NUMBER(args[2])) {
+        return argumentError("Inaasahan na makatanggap ng tagabuo, halaga at numero ang ulitin().");
+    }
 
-    char input[1024];
-    if (!fgets(input, sizeof(input), stdin)) {
-        printf("Hindi mabasa ang ibinigay na halaga.\n");
+    ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+    double times = AS_NUMBER(args[2]);
+    if (!(times >= 0)) {
+        return argumentError("Inaasahan na makatanggap ng bilang na hindi negatibo ang ulitin().");
+    }
+    if (times < 1) return NUMBER_VAL(builder->length);
+
+    int start = builder->length;
+    if (!appendValue(builder, args[1])) return NULL_VAL;
+
+    int length = builder->length - start;
+    if (length == 0) return NUMBER_VAL(builder->length);
+
+    if (times - 1 > (double)(INT_MAX - builder->length) / length) {
+        runtimeError("Masyadong mahaba ang salita.");
         return NULL_VAL;
     }
 
-    // fgets read the '\n' at the end that serves as the +1 for '\0'.
-    int length = strlen(input);
+    int rest = (int)times - 1;
+    if (!reserveChars(builder, length * rest)) return NULL_VAL;
+    for (int i = 0; i < rest; i++) {
+        memcpy(builder->chars + builder->length, builder->chars + start,
+               length);
+        builder->length += length;
+    }
+    return NUMBER_VAL(builder->length);
+}
 
-    int i = 0;
-    while (input[i] != '\0' && isdigit(input[i]))
-        i++;
+static Value buildNative(int argCount, Value* args) {
+    if (!IS_STRING_BUILDER(args[0])) {
+        return argumentError("Inaasahan na makatanggap ng tagabuo ang buuin().");
+    }
 
-    if (i != length && input[i] == '.')
-        while (input[i] != '\0' && isdigit(input[i]))
-            i++;
+    ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+    if (builder->length == 0) return OBJ_VAL(copyString("", 0));
 
-    input[length - 1] = '\0'; // Replace '\n' with '\0'.
-    if (i == length - 1)
-        return NUMBER_VAL(strtod(input, NULL));
-    else 
-        return OBJ_VAL(copyString(input, length));
+    return OBJ_VAL(copyString(builder->chars, builder->length));
+}
+
+// The element a pila or a tambak would give next from its front.
+static Value peekNative(int argCount, Value* args) {
+    if (IS_DEQUE(args[0])) {
+        ObjDeque* deque = AS_DEQUE(args[0]);
+        if (deque->count == 0) {
+            return argumentError("Walang laman ang pila na ibinigay sa silipin().");
+        }
+        return deque->values[deque->head];
+    }
+
+    if (IS_HEAP(args[0])) {
+        ValueArray* elements = &AS_HEAP(args[0])->elements;
+        if (elements->count == 0) {
+            return argumentError("Walang laman ang tambak na ibinigay sa silipin().");
+        }
+        return elements->values[0];
+    }
+
+    return argumentError("Inaasahan na makatanggap ng pila o tambak ang silipin().");
 }
 
 static Value clockNative(int argCount, Value* args) {
-    if (!(isSameArity(argCount, 0) && willNotOverflow()))
-        return NULL_VAL;
 
     return NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
 }
 
-static void defineNative(const char* name, NativeFn function) {
-    push(OBJ_VAL(copyString(name, (int)strlen(name))));
-    push(OBJ_VAL(newNative(function)));
+static Value flushNative(int argCount, Value* args) {
+    flushOutput();
+    return NULL_VAL;
+}
+
+// itakdaLabas("linya" | "buo", [laki]) picks when 'ipakita' output is
+// written and optionally how many bytes are kept before that.
+static Value outputModeNative(int argCount, Value* args) {
+    OutputMode mode;
+    ObjString* name = IS_STRING(args[0]) ? AS_STRING(args[0]) : NULL;
+    if (name != NULL && name->length == 5 &&
+        memcmp(name->chars, "linya", 5) == 0) {
+        mode = OUTPUT_LINE;
+    } else if (name != NULL && name->length == 3 &&
+               memcmp(name->chars, "buo", 3) == 0) {
+        mode = OUTPUT_FULL;
+    } else {
+        return argumentError("Inaasahan na makatanggap ng \"linya\" o \"buo\" ang itakdaLabas().");
+    }
+
+    if (argCount == 2) {
+        double size = IS_NUMBER(args[1]) ? AS_NUMBER(args[1]) : 0;
+        if (!(size >= 1 && size <= INT_MAX) || size != (int)size) {
+            return argumentError("Inaasahan na makatanggap ng buong numero na higit sa 0 bilang laki ang itakdaLabas().");
+        }
+
+        flushOutput();
+        char* chars = (char*)realloc(vm.output.chars, (size_t)size);
+        if (chars == NULL) exit(1);
+        vm.output.chars = chars;
+        vm.output.capacity = (int)size;
+    }
+
+    vm.output.mode = mode;
+    return NULL_VAL;
+}
+
+typedef struct {
+    const char* name;
+    NativeFn function;
+    int minArity;
+    int maxArity;
+    uint8_t flags;
+    NativeCheck check;  // Left out by the natives that check as they go.
+} NativeDef;
+
+static const NativeDef natives[] = {
+    {"oras",            clockNative,         0, 0, 0},
+    {"basahin",         scanNative,          0, 0, NATIVE_ALLOCATE},
+    {"mayKatangian",    hasFieldNative,      2, 2, 0},
+    {"ilabas",          flushNative,         0, 0, 0},
+    {"itakdaLabas",     outputModeNative,    1, 2, 0},
+    {"sukatSalita",     stringLengthNative,  1, 1, NATIVE_PURE, checkStringLength},
+    {"bilangNumero",    charToIntNative,     1, 2, NATIVE_PURE, checkCharToInt},
+    {"saklaw",          rangeNative,         2, 2, NATIVE_ALLOCATE},
+
+    {"haba",            lengthNative,        1, 1, NATIVE_PURE, checkLength},
+    {"idagdag",         pushNative,          2, 2, NATIVE_ALLOCATE | NATIVE_REENTER},
+    {"tanggalin",       popNative,           1, 1, NATIVE_REENTER},
+    {"isingit",         insertNative,        3, 3, NATIVE_ALLOCATE},
+    {"alisin",          removeNative,        2, 2, 0},
+    {"hiwain",          sliceNative,         3, 3, NATIVE_PURE | NATIVE_ALLOCATE, checkSlice},
+    {"punuin",          fillNative,          2, 2, 0},
+    {"baligtarin",      reverseNative,       1, 1, 0},
+    {"hanapin",         indexOfNative,       2, 3, NATIVE_PURE, checkIndexOf},
+    {"kopyahin",        copyNative,          1, 1, NATIVE_ALLOCATE},
+    {"ayusin",          sortNative,          1, 2, NATIVE_ALLOCATE | NATIVE_REENTER},
+    {"ayusinMatatag",   stableSortNative,    1, 2, NATIVE_ALLOCATE | NATIVE_REENTER},
+
+    {"kabuuan",         sumNative,           1, 1, NATIVE_ALLOCATE},
+    {"tuldokProdukto",  dotNative,           2, 2, NATIVE_ALLOCATE},
+    {"pinakamaliit",    minNative,           1, 1, 0},
+    {"pinakamalaki",    maxNative,           1, 1, 0},
+    {"indeksNgPinakamaliit", minIndexNative, 1, 1, 0},
+    {"paramihin",       scaleNative,         2, 2, NATIVE_ALLOCATE},
+    {"dagdagan",        addNative,           2, 2, NATIVE_ALLOCATE},
+    {"ipunin",          prefixSumNative,     1, 1, NATIVE_ALLOCATE},
+    {"bilangin",        countNative,         2, 2, 0},
+
+    {"mgaSusi",         keysNative,          1, 1, NATIVE_ALLOCATE},
+    {"mgaHalaga",       valuesNative,        1, 1, NATIVE_ALLOCATE},
+    {"maySusi",         hasKeyNative,        2, 2, 0},
+    {"burahin",         deleteNative,        2, 2, 0},
+
+    {"kalipunan",       setNative,           0, 1, NATIVE_ALLOCATE},
+    {"pila",            dequeNative,         0, 1, NATIVE_ALLOCATE},
+    {"tambak",          heapNative,          0, 1, NATIVE_ALLOCATE},
+    {"idagdagSaUna",    pushFrontNative,     2, 2, NATIVE_ALLOCATE},
+    {"tanggalinSaUna",  popFrontNative,      1, 1, 0},
+    {"silipin",         peekNative,          1, 1, 0},
+
+    {"hatiin",          splitNative,         2, 2, NATIVE_ALLOCATE},
+    {"nagsisimulaSa",   startsWithNative,    2, 2, NATIVE_PURE, checkStartsWith},
+    {"nagtataposSa",    endsWithNative,      2, 2, NATIVE_PURE, checkEndsWith},
+    {"ihambing",        compareNative,       2, 2, NATIVE_PURE, checkCompare},
+    {"mgaBilangNumero", bytesNative,         1, 1, NATIVE_ALLOCATE},
+
+    {"tagabuo",         stringBuilderNative, 0, 1, NATIVE_ALLOCATE},
+    {"ulitin",          repeatNative,        3, 3, NATIVE_ALLOCATE},
+    {"buuin",           buildNative,         1, 1, NATIVE_ALLOCATE},
+};
+
+static void defineNative(const NativeDef* def) {
+    push(OBJ_VAL(copyString(def->name, (int)strlen(def->name))));
+    push(OBJ_VAL(newNative(def->function, def->check, def->minArity,
+                           def->maxArity, def->flags)));
     tableSet(&vm.globals, AS_STRING(vm.stack[0]), vm.stack[1]);
     pop();
     pop();
@@ -139,6 +1676,15 @@ static void defineNative(const char* name, NativeFn function) {
 
 void initVM() {
     resetStack();
+
+    // The buffer is not a heap object, so it is kept out of the GC's count.
+    vm.output.chars = (char*)malloc(OUTPUT_BUFFER_SIZE);
+    if (vm.output.chars == NULL) exit(1);
+    vm.output.length = 0;
+    vm.output.capacity = OUTPUT_BUFFER_SIZE;
+    // Someone is watching a terminal, so every line shows up right away.
+    vm.output.mode = isatty(fileno(stdout)) ? OUTPUT_LINE : OUTPUT_FULL;
+
     vm.objects = NULL;
     vm.bytesAllocated = 0;
     vm.nextGC = 1024 * 1024;
@@ -152,19 +1698,23 @@ void initVM() {
     initTable(&vm.strings);
 
     vm.initString = NULL;
+    memset(vm.charStrings, 0, sizeof(vm.charStrings));
     vm.initString = copyString("sim", 3);
 
-    defineNative("oras", clockNative);
-    defineNative("basahin", scanNative);
-    defineNative("mayKatangian", hasFieldNative);
-    defineNative("sukatSalita", stringLengthNative);
-    defineNative("bilangNumero", charToIntNative);
+    for (size_t i = 0; i < sizeof(natives) / sizeof(natives[0]); i++) {
+        defineNative(&natives[i]);
+    }
 }
 
 void freeVM() {
+    flushOutput();
+    free(vm.output.chars);
+    vm.output.chars = NULL;
+
     freeTable(&vm.globals);
     freeTable(&vm.strings);
     vm.initString = NULL;
+    memset(vm.charStrings, 0, sizeof(vm.charStrings));
     freeObjects();
 }
 
@@ -182,10 +1732,18 @@ static Value peek(int distance) {
     return vm.stackTop[-1 - distance];
 }
 
-static bool call(ObjClosure* closure, int argCount) {
-    if (!(isSameArity(argCount, closure->function->arity) &&
-          willNotOverflow()))
+// Pushes the frame of a closure already known to be compiled and to take
+// argCount arguments.
+static bool enterFrame(ObjClosure* closure, int argCount) {
+    if (!willNotOverflow()) return false;
+
+    // Functions may have more than UINT8_COUNT locals so the frame count
+    // alone does not guarantee that the stack can hold them.
+    if (vm.stackTop - argCount - 1 + closure->function->slotCount >
+        vm.stack + STACK_MAX) {
+        runtimeError("Umaapaw ang salansan.");
         return false;
+    }
 
     CallFrame* frame = &vm.frames[vm.frameCount++];
     frame->closure = closure;
@@ -194,24 +1752,42 @@ static bool call(ObjClosure* closure, int argCount) {
     return true;
 }
 
+static bool call(ObjClosure* closure, int argCount) {
+    if (!isSameArity(argCount, closure->function->arity)) return false;
+
+    if (closure->function->source != NULL &&
+        !compileFunction(closure->function)) {
+        runtimeError("Hindi maisalin ang gawain na '%s'.",
+                     closure->function->name->chars);
+        return false;
+    }
+
+    return enterFrame(closure, argCount);
+}
+
+// A native that calls back into the script may end with a runtime error,
+// which resets the stack.
+static bool callNative(ObjNative* native, int argCount) {
+    Value* args = vm.stackTop - argCount;
+    if (native->check != NULL) {
+        const char* error = native->check(argCount, args);
+        if (error != NULL) {
+            runtimeError("%s", error);
+            return false;
+        }
+    }
+
+    Value result = native->function(argCount, args);
+    if (vm.frameCount == 0) return false;
+
+    vm.stackTop -= argCount + 1;
+    push(result);
+    return true;
+}
+
 static bool callValue(Value callee, int argCount) {
     if (IS_OBJ(callee)) {
         switch (OBJ_TYPE(callee)) {
-            case OBJ_ARRAY: {
-                // argCount here serves as the index of the element.
-                ObjArray* array = AS_ARRAY(callee);
-                if (argCount >= array->elements.count) {
-                    runtimeError("Ang koleksyon ay naglalaman ng %d elemento ngunit nakatanggap ng %d.",
-                        array->elements.count, argCount);
-                    return false;
-                }
-
-                if (argCount < 0)
-                    push(array->elements.values[array->elements.count + argCount]);
-                else
-                    push(array->elements.values[argCount]);
-                return true;
-            }
             case OBJ_BOUND_METHOD: {
                 ObjBoundMethod* bound = AS_BOUND_METHOD(callee);
                 vm.stackTop[-argCount - 1] = bound->receiver;
@@ -233,11 +1809,17 @@ static bool callValue(Value callee, int argCount) {
             case OBJ_CLOSURE:
                 return call(AS_CLOSURE(callee), argCount);
             case OBJ_NATIVE: {
-                NativeFn native = AS_NATIVE(callee);
-                Value result = native(argCount, vm.stackTop - argCount);
-                vm.stackTop -= argCount + 1;
-                push(result);
-                return true;
+                ObjNative* native = (ObjNative*)AS_OBJ(callee);
+                if (native->minArity == native->maxArity) {
+                    if (!isSameArity(argCount, native->minArity)) return false;
+                } else if (argCount < native->minArity ||
+                           argCount > native->maxArity) {
+                    runtimeError("Inaasahan na makakita ng %d hanggang %d argumento ngunit nakakita ng %d.",
+                        native->minArity, native->maxArity, argCount);
+                    return false;
+                }
+
+                return callNative(native, argCount);
             }
             default:
                 break; // Non-callable object type.
@@ -247,6 +1829,18 @@ static bool callValue(Value callee, int argCount) {
     return false;
 }
 
+static InterpretResult run(int baseFrame);
+
+// Lets a native call a function that is on the stack with its arguments
+// and runs it to completion. The result is left in their place.
+static bool callFunction(Value callee, int argCount) {
+    int baseFrame = vm.frameCount;
+    if (!callValue(callee, argCount)) return false;
+    if (vm.frameCount == baseFrame) return true; // Done without a frame.
+
+    return run(baseFrame) == INTERPRET_OK;
+}
+
 static bool invokeFromClass(ObjClass* klass, ObjString* name, int argCount) {
     Value method;
     if (!tableGet(&klass->methods, name, &method)) {
@@ -357,78 +1951,435 @@ static ObjString* toString(Value value, char* buffer) {
                 return NULL;
             }
 
-            return AS_STRING(value);
-        }
+            return AS_STRING(value);
+        }
+    }
+}
+
+static bool concatenate() {
+    char bBuffer[VAL_BUFFER_SIZE];
+    char aBuffer[VAL_BUFFER_SIZE];
+    // The strings made from other values are kept on the stack until the
+    // result is allocated.
+    ObjString* b = toString(peek(0), bBuffer);
+    if (b == NULL) return false;
+    push(OBJ_VAL(b));
+
+    ObjString* a = toString(peek(2), aBuffer);
+    if (a == NULL) return false;
+    push(OBJ_VAL(a));
+
+    int length = a->length + b->length;
+    ObjString* result = makeString(length);
+    memcpy(result->chars, a->chars, a->length);
+    memcpy(result->chars + a->length, b->chars, b->length);
+    result->chars[length] = '\0';
+
+    vm.stackTop -= 4;
+    push(OBJ_VAL(result));
+    uint32_t hash = hashStringFrom(a->hash, b->chars, b->length);
+    vm.stackTop[-1] = OBJ_VAL(internString(result, hash));
+    return true;
+}
+
+// Computes 'a <operation> b' for the two values on top of the stack the
+// same way the arithmetic instructions do, leaving the result in their
+// place.
+static bool arithmetic(uint8_t operation) {
+    if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
+        double b = AS_NUMBER(pop());
+        double a = AS_NUMBER(pop());
+        switch (operation) {
+            case OP_ADD:      push(NUMBER_VAL(a + b)); break;
+            case OP_SUBTRACT: push(NUMBER_VAL(a - b)); break;
+            case OP_MULTIPLY: push(NUMBER_VAL(a * b)); break;
+            case OP_DIVIDE:   push(NUMBER_VAL(a / b)); break;
+        }
+        return true;
+    }
+
+    if (operation != OP_ADD) {
+        runtimeError("Inaasahang parehong numero ang gamit.");
+        return false;
+    }
+
+    if (!concatenate()) {
+        runtimeError("Hindi makabuo ng salita gamit.");
+        return false;
+    }
+    return true;
+}
+
+// Applies a compound assignment to the variable with the operand on top of
+// the stack. The operand is replaced by the new value.
+static bool modify(Value* variable, uint8_t operation) {
+    Value operand = pop();
+    push(*variable);
+    push(operand);
+    if (!arithmetic(operation)) return false;
+
+    *variable = peek(0);
+    return true;
+}
+
+// Adds or subtracts one in place, without leaving anything on the stack.
+static bool step(Value* variable, uint8_t operation) {
+    if (IS_NUMBER(*variable)) {
+        double delta = operation == OP_ADD ? 1 : -1;
+        *variable = NUMBER_VAL(AS_NUMBER(*variable) + delta);
+        return true;
+    }
+
+    push(NUMBER_VAL(1));
+    if (!modify(variable, operation)) return false;
+    pop();
+    return true;
+}
+
+static bool stepGlobal(ObjString* name, uint8_t operation) {
+    Value value;
+    if (!tableGet(&vm.globals, name, &value)) {
+        runtimeError("Hindi kilala ang lagayan '%s'.", name->chars);
+        return false;
+    }
+
+    push(value);
+    if (!step(vm.stackTop - 1, operation)) return false;
+    tableSet(&vm.globals, name, pop());
+    return true;
+}
+
+// Rewrites the instruction just read into its form specialized for the
+// operands it saw, unless it already fell back from it too many times.
+static void quicken(CallFrame* frame, uint8_t* ip, uint8_t specialized) {
+    Chunk* chunk = &frame->closure->function->chunk;
+    int offset = (int)(ip - 1 - chunk->code);
+    if (QUICKEN_MAX_FALLBACKS == 0 || (chunk->fallbacks != NULL &&
+        chunk->fallbacks[offset] >= QUICKEN_MAX_FALLBACKS)) {
+        return;
+    }
+
+    ip[-1] = specialized;
+}
+
+static void fallBack(CallFrame* frame, uint8_t* ip, uint8_t generic) {
+    Chunk* chunk = &frame->closure->function->chunk;
+    if (chunk->fallbacks == NULL) {
+        chunk->fallbacks = ALLOCATE(uint8_t, chunk->count);
+        memset(chunk->fallbacks, 0, chunk->count);
+    }
+
+    int offset = (int)(ip - 1 - chunk->code);
+    if (chunk->fallbacks[offset] < UINT8_MAX) chunk->fallbacks[offset]++;
+    ip[-1] = generic;
+}
+
+static bool isInteger(Value value) {
+    if (!IS_NUMBER(value)) return false;
+
+    double number = AS_NUMBER(value);
+    return number >= INT32_MIN && number <= INT32_MAX && number == (int)number;
+}
+
+// Whether 'array[i + offset]' stays inside the array for every 'i' from
+// start while 'i < end' (or 'i <= end'), stepping by one.
+static bool checkRange(Value array, Value start, Value end, Value offset,
+                       uint8_t flags) {
+    if (!IS_ARRAY(array) || !isInteger(start) || !isInteger(end) ||
+        !isInteger(offset)) {
+        return false;
+    }
+
+    double first = AS_NUMBER(start);
+    double last = AS_NUMBER(end);
+    if (flags & RANGE_INCLUSIVE) last++;
+    if (first >= last) return true; // The loop body never runs.
+
+    double delta = AS_NUMBER(offset);
+    if (flags & RANGE_SUBTRACT) delta = -delta;
+    return first + delta >= 0 &&
+        last + delta <= AS_ARRAY(array)->elements.count;
+}
+
+// Checks index against the size of the first dimension of a collection.
+// Negative indexes count from the end.
+static bool elementOffset(Value index, int count, int* offset) {
+    if (!IS_NUMBER(index)) {
+        runtimeError("Inaasahan na makatanggap ng numero bilang indeks.");
+        return false;
+    }
+
+    // Written so that NaN is out of bounds as well.
+    double position = AS_NUMBER(index);
+    if (!(position < count && position > -count - 1)) {
+        runtimeError("Ang koleksyon ay naglalaman ng %d elemento ngunit nakatanggap ng %g.",
+            count, position);
+        return false;
+    }
+
+    *offset = (int)position;
+    if (*offset < 0) *offset += count;
+    return true;
+}
+
+// The element that can be assigned to at array[index].
+static Value* arrayElement(Value array, Value index) {
+    int offset;
+    if (IS_ARRAY(array)) {
+        ValueArray* elements = &AS_ARRAY(array)->elements;
+        if (!elementOffset(index, elements->count, &offset)) return NULL;
+        return &elements->values[offset];
+    }
+
+    if (IS_GRID(array)) {
+        ObjGrid* grid = AS_GRID(array);
+        if (!elementOffset(index, grid->sizes[0], &offset)) return NULL;
+        if (grid->dimensions > 1) {
+            runtimeError("Hindi maaaring palitan ang buong hanay ng koleksyon na may %d dimensyon.",
+                grid->dimensions);
+            return NULL;
+        }
+        return &grid->values[offset];
+    }
+
+    if (IS_DEQUE(array)) {
+        ObjDeque* deque = AS_DEQUE(array);
+        if (!elementOffset(index, deque->count, &offset)) return NULL;
+        return &deque->values[(deque->head + offset) % deque->capacity];
+    }
+
+    if (IS_STRING(array)) {
+        runtimeError("Hindi maaaring palitan ang mga titik ng salita.");
+        return NULL;
+    }
+
+    runtimeError("Tanging koleksyon lamang ang maaaring tawagin gamit ang '[]'.");
+    return NULL;
+}
+
+// Reads array[index]. A row of a grid is handed out as a view.
+static bool getElement(Value array, Value index, Value* element) {
+    if (IS_STRING(array)) {
+        ObjString* string = AS_STRING(array);
+        int offset;
+        if (!elementOffset(index, string->length, &offset)) return false;
+
+        *element = OBJ_VAL(charString(string->chars[offset]));
+        return true;
+    }
+
+    if (IS_MAP(array)) {
+        // A missing key reads as null.
+        if (!valueTableGet(&AS_MAP(array)->table, index, element)) {
+            *element = NULL_VAL;
+        }
+        return true;
+    }
+
+    if (IS_GRID(array) && AS_GRID(array)->dimensions > 1) {
+        ObjGrid* grid = AS_GRID(array);
+        int offset;
+        if (!elementOffset(index, grid->sizes[0], &offset)) return false;
+
+        *element = OBJ_VAL(newGridView(grid, 1, offset * grid->strides[0]));
+        return true;
+    }
+
+    Value* slot = arrayElement(array, index);
+    if (slot == NULL) return false;
+
+    *element = *slot;
+    return true;
+}
+
+// Offset of grid[i][j] from the start of the grid.
+static bool gridOffset(ObjGrid* grid, Value i, Value j, int* offset) {
+    int row;
+    int column;
+    if (!elementOffset(i, grid->sizes[0], &row) ||
+        !elementOffset(j, grid->sizes[1], &column)) {
+        return false;
+    }
+
+    *offset = row * grid->strides[0] + column * grid->strides[1];
+    return true;
+}
+
+// Reads array[i][j], in one step for a grid.
+static bool getElement2D(Value array, Value i, Value j, Value* element) {
+    if (!IS_GRID(array) || AS_GRID(array)->dimensions < 2) {
+        Value row;
+        return getElement(array, i, &row) && getElement(row, j, element);
+    }
+
+    ObjGrid* grid = AS_GRID(array);
+    int offset;
+    if (!gridOffset(grid, i, j, &offset)) return false;
+
+    *element = grid->dimensions == 2 ? grid->values[offset] :
+        OBJ_VAL(newGridView(grid, 2, offset));
+    return true;
+}
+
+static bool mapSet(ObjMap* map, Value key, Value value) {
+    if (!checkKey(key)) return false;
+
+    if (valueTableSet(&map->table, key, value)) map->count++;
+    return true;
+}
+
+// Assigns array[index]. A diksyunaryo adds the key if it is missing.
+static bool setElement(Value array, Value index, Value value) {
+    if (IS_MAP(array)) return mapSet(AS_MAP(array), index, value);
+
+    Value* element = arrayElement(array, index);
+    if (element == NULL) return false;
+
+    *element = value;
+    return true;
+}
+
+static bool setElement2D(Value array, Value i, Value j, Value value) {
+    if (IS_GRID(array) && AS_GRID(array)->dimensions == 2) {
+        ObjGrid* grid = AS_GRID(array);
+        int offset;
+        if (!gridOffset(grid, i, j, &offset)) return false;
+
+        grid->values[offset] = value;
+        return true;
     }
+
+    Value row;
+    return getElement(array, i, &row) && setElement(row, j, value);
 }
 
-static bool concatenate() {
-    char bBuffer[VAL_BUFFER_SIZE];
-    char aBuffer[VAL_BUFFER_SIZE];
-    ObjString* b = toString(peek(0), bBuffer);
-    ObjString* a = toString(peek(1), aBuffer);
+// Applies the operation to array[index] and the operand on top of the
+// stack, replacing the operand with the result.
+static bool modifyElement(Value array, Value index, uint8_t operation) {
+    if (IS_MAP(array)) {
+        Value element;
+        return getElement(array, index, &element) &&
+            modify(&element, operation) &&
+            mapSet(AS_MAP(array), index, element);
+    }
 
-    if (b == NULL || a == NULL) return false;
+    Value* element = arrayElement(array, index);
+    return element != NULL && modify(element, operation);
+}
 
-    int length = a->length + b->length;
-    ObjString* result = makeString(length);
-    memcpy(result->chars, a->chars, a->length);
-    memcpy(result->chars + a->length, b->chars, b->length);
-    result->chars[length] = '\0';
+static bool modifyElement2D(Value array, Value i, Value j,
+                            uint8_t operation) {
+    if (IS_GRID(array) && AS_GRID(array)->dimensions == 2) {
+        ObjGrid* grid = AS_GRID(array);
+        int offset;
+        if (!gridOffset(grid, i, j, &offset)) return false;
 
-    pop();
-    pop();
-    push(OBJ_VAL(result));
-    return true;
+        return modify(&grid->values[offset], operation);
+    }
+
+    Value row;
+    return getElement(array, i, &row) && modifyElement(row, j, operation);
 }
 
-static InterpretResult run() {
+// Runs until the frames go back down to baseFrame.
+static InterpretResult run(int baseFrame) {
     CallFrame* frame = &vm.frames[vm.frameCount - 1];
     register uint8_t* ip = frame->ip;
 
 #define READ_BYTE() (*ip++)
 
+#define READ_SHORT() \
+    (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+
+#define READ_LONG() \
+    (ip += 3, (uint32_t)((ip[-3] << 16) | (ip[-2] << 8) | ip[-1]))
+
 #define READ_CONSTANT() \
     (frame->closure->function->chunk.constants.values[READ_BYTE()])
 
-#define READ_SHORT() \
-    (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_LONG_CONSTANT() \
+    (frame->closure->function->chunk.constants.values[READ_LONG()])
+
+// A signed 16-bit operand embedded in the instruction.
+#define READ_IMMEDIATE() ((int16_t)READ_SHORT())
 
 #define READ_STRING() AS_STRING(READ_CONSTANT())
-#define BINARY_OP(valueType, op) \
+#define READ_LONG_STRING() AS_STRING(READ_LONG_CONSTANT())
+
+// For instructions sharing one case with their OP_LONG_* twin.
+#define READ_NAME(shortOp) \
+    (instruction == (shortOp) ? READ_STRING() : READ_LONG_STRING())
+#define READ_SLOT(shortOp) \
+    (instruction == (shortOp) ? READ_BYTE() : READ_LONG())
+#define BINARY_OP(valueType, op, specialized) \
     do { \
         if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
             frame->ip = ip; \
             runtimeError("Inaasahang parehong numero ang gamit."); \
             return INTERPRET_RUNTIME_ERROR; \
         } \
+        quicken(frame, ip, specialized); \
         double b = AS_NUMBER(pop()); \
         double a = AS_NUMBER(pop()); \
         push(valueType(a op b)); \
     } while (false)
 
+// The specialized form of a BINARY_OP. It goes back to the generic
+// instruction, and runs it instead, once an operand is not a number.
+#define NUMBER_OP(valueType, op, generic) \
+    do { \
+        if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) { \
+            fallBack(frame, ip, generic); \
+            ip--; \
+            break; \
+        } \
+        double b = AS_NUMBER(peek(0)); \
+        vm.stackTop--; \
+        vm.stackTop[-1] = valueType(AS_NUMBER(peek(0)) op b); \
+    } while (false)
+
+// Replaces the value on top of the stack, the right operand is immediate.
+#define IMMEDIATE_OP(valueType, op) \
+    do { \
+        double b = READ_IMMEDIATE(); \
+        if (!IS_NUMBER(peek(0))) { \
+            frame->ip = ip; \
+            runtimeError("Inaasahang parehong numero ang gamit."); \
+            return INTERPRET_RUNTIME_ERROR; \
+        } \
+        vm.stackTop[-1] = valueType(AS_NUMBER(peek(0)) op b); \
+    } while (false)
+
     for (;;) {
 #ifdef DEBUG_TRACE_EXECUTION
-    printf("          ");
+    writeOutput("          ");
     for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
-        printf("[ ");
+        writeOutput("[ ");
         printValue(*slot);
-        printf(" ]");
+        writeOutput(" ]");
     }
 
-    printf("\n");
+    writeOutput("\n");
+    flushOutput();
     disassembleInstruction(&frame->closure->function->chunk,
         (int)(ip - frame->closure->function->chunk.code));
 #endif
 
         uint8_t instruction;
         switch (instruction = READ_BYTE()) {
-            case OP_LONG_CONSTANT:
             case OP_CONSTANT: {
                 Value constant = READ_CONSTANT();
                 push(constant);
                 break;
             }
+            case OP_LONG_CONSTANT: {
+                Value constant = READ_LONG_CONSTANT();
+                push(constant);
+                break;
+            }
+            case OP_PUSH_SMALL_INT:
+                push(NUMBER_VAL(READ_IMMEDIATE()));
+                break;
             case OP_NULL: push(NULL_VAL); break;
             case OP_TRUE: push(BOOL_VAL(true)); break;
             case OP_FALSE: push(BOOL_VAL(false)); break;
@@ -439,13 +2390,46 @@ static InterpretResult run() {
                 push(frame->slots[slot]);
                 break;
             }
+            case OP_LONG_GET_LOCAL: {
+                uint32_t slot = READ_LONG();
+                push(frame->slots[slot]);
+                break;
+            }
             case OP_SET_LOCAL: {
                 uint8_t slot = READ_BYTE();
                 frame->slots[slot] = peek(0);
                 break;
             }
-            case OP_GET_GLOBAL: {
-                ObjString* name = READ_STRING();
+            case OP_LONG_SET_LOCAL: {
+                uint32_t slot = READ_LONG();
+                frame->slots[slot] = peek(0);
+                break;
+            }
+            case OP_INC_LOCAL:
+            case OP_LONG_INC_LOCAL: {
+                Value* slot = &frame->slots[READ_SLOT(OP_INC_LOCAL)];
+                frame->ip = ip;
+                if (!step(slot, OP_ADD)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            case OP_DEC_LOCAL:
+            case OP_LONG_DEC_LOCAL: {
+                Value* slot = &frame->slots[READ_SLOT(OP_DEC_LOCAL)];
+                frame->ip = ip;
+                if (!step(slot, OP_SUBTRACT)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            case OP_MODIFY_LOCAL:
+            case OP_LONG_MODIFY_LOCAL: {
+                Value* slot = &frame->slots[READ_SLOT(OP_MODIFY_LOCAL)];
+                uint8_t operation = READ_BYTE();
+                frame->ip = ip;
+                if (!modify(slot, operation)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            case OP_GET_GLOBAL:
+            case OP_LONG_GET_GLOBAL: {
+                ObjString* name = READ_NAME(OP_GET_GLOBAL);
                 Value value;
                 if (!tableGet(&vm.globals, name, &value)) {
                     frame->ip = ip;
@@ -455,14 +2439,16 @@ static InterpretResult run() {
                 push(value);
                 break;
             }
-            case OP_DEFINE_GLOBAL: {
-                ObjString* name = READ_STRING();
+            case OP_DEFINE_GLOBAL:
+            case OP_LONG_DEFINE_GLOBAL: {
+                ObjString* name = READ_NAME(OP_DEFINE_GLOBAL);
                 tableSet(&vm.globals, name, peek(0));
                 pop();
                 break;
             }
-            case OP_SET_GLOBAL: {
-                ObjString* name = READ_STRING();
+            case OP_SET_GLOBAL:
+            case OP_LONG_SET_GLOBAL: {
+                ObjString* name = READ_NAME(OP_SET_GLOBAL);
                 if (tableSet(&vm.globals, name, peek(0))) {
                     tableDelete(&vm.globals, name);
                     frame->ip = ip;
@@ -471,43 +2457,113 @@ static InterpretResult run() {
                 }
                 break;
             }
-            case OP_GET_ELEMENT: {
-                Value index = pop();
-                Value array = pop();
-
+            case OP_INC_GLOBAL:
+            case OP_LONG_INC_GLOBAL: {
+                ObjString* name = READ_NAME(OP_INC_GLOBAL);
                 frame->ip = ip;
-                if (!IS_ARRAY(array)) {
-                    runtimeError("Tanging koleksyon lamang ang maaaring tawagin gamit ang '[]'.");
+                if (!stepGlobal(name, OP_ADD)) return INTERPRET_RUNTIME_ERROR;
+                break;
+            }
+            case OP_DEC_GLOBAL:
+            case OP_LONG_DEC_GLOBAL: {
+                ObjString* name = READ_NAME(OP_DEC_GLOBAL);
+                frame->ip = ip;
+                if (!stepGlobal(name, OP_SUBTRACT)) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
+            case OP_MODIFY_GLOBAL:
+            case OP_LONG_MODIFY_GLOBAL: {
+                ObjString* name = READ_NAME(OP_MODIFY_GLOBAL);
+                uint8_t operation = READ_BYTE();
+                frame->ip = ip;
+
+                Value value;
+                if (!tableGet(&vm.globals, name, &value)) {
+                    runtimeError("Hindi kilala ang lagayan '%s'.", name->chars);
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                if (!IS_NUMBER(index)) {
-                    runtimeError("Inaasahan na makatanggap ng numero bilang indeks.");
+                Value operand = peek(0);
+                vm.stackTop[-1] = value;
+                push(operand);
+                if (!arithmetic(operation)) return INTERPRET_RUNTIME_ERROR;
+                tableSet(&vm.globals, name, peek(0));
+                break;
+            }
+            case OP_DEFINED:
+            case OP_LONG_DEFINED: {
+                ObjString* name = READ_NAME(OP_DEFINED);
+                Value value;
+                push(BOOL_VAL(tableGet(&vm.globals, name, &value)));
+                break;
+            }
+            case OP_GET_ELEMENT: {
+                frame->ip = ip;
+                Value element;
+                if (!getElement(peek(1), peek(0), &element)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                if (!callValue(array, (int)AS_NUMBER(index))) {
+                vm.stackTop[-2] = element;
+                vm.stackTop--;
+                break;
+            }
+            case OP_GET_ELEMENT_2D: {
+                frame->ip = ip;
+                Value element;
+                if (!getElement2D(peek(2), peek(1), peek(0), &element)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
-                ip = frame->ip;
 
+                vm.stackTop[-3] = element;
+                vm.stackTop -= 2;
                 break;
             }
-            case OP_DEFINE_ARRAY: {
-                uint8_t elementCount = READ_BYTE();
+            case OP_GET_ELEMENT_UNCHECKED: {
+                // The loop guard already checked the array and the index.
+                int index = (int)AS_NUMBER(pop());
+                vm.stackTop[-1] = AS_ARRAY(peek(0))->elements.values[index];
+                break;
+            }
+            case OP_DEFINE_ARRAY:
+            case OP_LONG_DEFINE_ARRAY: {
+                uint32_t elementCount = instruction == OP_DEFINE_ARRAY ?
+                    READ_BYTE() : READ_LONG();
                 ObjArray* array = newArray();
+                push(OBJ_VAL(array)); // Keep it reachable while it grows.
 
+                // Skip the array itself, the elements are below it in order.
+                // i.e. [ 1, 2, 3, 4] -> 1 2 3 4 [] in stack.
                 int i = elementCount;
-                // Use peek() since stack values are in reversed order. 
-                // i.e. [ 1, 2, 3, 4] -> [ 4, 3, 2, 1] in stack.
                 while (i > 0)
-                    writeValueArray(&array->elements, peek(--i));
+                    writeValueArray(&array->elements, peek(i--));
 
-                vm.stackTop -= elementCount; // Remove elemets.
+                vm.stackTop -= elementCount + 1; // Remove elemets.
 
                 push(OBJ_VAL(array));
                 break;
             }
+            case OP_DEFINE_MAP:
+            case OP_LONG_DEFINE_MAP: {
+                uint32_t pairCount = READ_SLOT(OP_DEFINE_MAP);
+                ObjMap* map = newMap();
+                push(OBJ_VAL(map)); // Keep it reachable while it grows.
+
+                // The keys and values are below the map in order.
+                Value* pairs = vm.stackTop - 1 - pairCount * 2;
+                frame->ip = ip;
+                for (uint32_t i = 0; i < pairCount; i++) {
+                    if (!mapSet(map, pairs[i * 2], pairs[i * 2 + 1])) {
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+                }
+
+                vm.stackTop = pairs;
+                push(OBJ_VAL(map));
+                break;
+            }
             case OP_DECLARE_ARRAY: {
                 // The element count here does not rely on the number of compiled expressions.
                 // The element count comes from the "value" of the compiled expression arr[n].
@@ -526,67 +2582,172 @@ static InterpretResult run() {
                 }
 
                 ObjArray* array = newArray();
+                push(OBJ_VAL(array));
 
                 int i = AS_NUMBER(elementCount);
                 // The array will be initialized with NULL.
                 while (i-- > 0)
                     writeValueArray(&array->elements, NULL_VAL);
 
-                push(OBJ_VAL(array));
                 break;
             }
             case OP_MULTI_ARRAY: {
-                // - 1 was the rightmost array that was already processed.
-                uint8_t dimension = READ_BYTE() - 1;
-
-                while (dimension-- > 0) {
-                    ObjArray* array = AS_ARRAY(pop());
-                    int enclosingArraySize = (int)AS_NUMBER(pop());
-
-                    ObjArray* enclosing = newArray();
-                    while (enclosingArraySize-- > 0) {
-                        ObjArray* element = newArray();
-                        copyValueArray(&array->elements, &element->elements);
-                        writeValueArray(&enclosing->elements, OBJ_VAL(element));
+                // Stack: the size of each dimension, the first one deepest.
+                uint8_t dimensions = READ_BYTE();
+                int sizes[UINT8_MAX];
+                double count = 1;
+                for (int i = 0; i < dimensions; i++) {
+                    Value size = peek(dimensions - 1 - i);
+                    // Also catches NaN, which fails every comparison.
+                    if (!IS_NUMBER(size) || !(AS_NUMBER(size) >= 0)) {
+                        frame->ip = ip;
+                        runtimeError("Inaasahan na makatanggap ng numero na higit sa 0 para sa bilang ng mga elemento.");
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+
+                    if (!(AS_NUMBER(size) <= INT_MAX)) {
+                        frame->ip = ip;
+                        runtimeError("Masyadong maraming elemento para sa isang koleksyon.");
+                        return INTERPRET_RUNTIME_ERROR;
                     }
 
-                    push(OBJ_VAL(enclosing));
+                    sizes[i] = (int)AS_NUMBER(size);
+                    count *= sizes[i];
+                    if (count > INT_MAX) {
+                        frame->ip = ip;
+                        runtimeError("Masyadong maraming elemento para sa isang koleksyon.");
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
                 }
 
+                ObjGrid* grid = newGrid(dimensions, sizes);
+                vm.stackTop -= dimensions;
+                push(OBJ_VAL(grid));
                 break;
             }
             case OP_SET_ELEMENT: {
+                frame->ip = ip;
+                if (!setElement(peek(2), peek(1), peek(0))) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                vm.stackTop[-3] = peek(0); // Leave the value on the stack.
+                vm.stackTop -= 2;
+                break;
+            }
+            case OP_SET_ELEMENT_2D: {
+                frame->ip = ip;
+                if (!setElement2D(peek(3), peek(2), peek(1), peek(0))) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                vm.stackTop[-4] = peek(0);
+                vm.stackTop -= 3;
+                break;
+            }
+            case OP_SET_ELEMENT_UNCHECKED: {
                 Value value = pop();
-                Value index = pop();
-                Value array = pop();
+                int index = (int)AS_NUMBER(pop());
+                AS_ARRAY(peek(0))->elements.values[index] = value;
+                vm.stackTop[-1] = value;
+                break;
+            }
+            case OP_CHECK_RANGE: {
+                uint8_t flags = READ_BYTE();
+                bool isInRange = checkRange(peek(3), peek(2), peek(1),
+                                            peek(0), flags);
+                vm.stackTop -= 4;
+                push(BOOL_VAL(isInRange));
+                break;
+            }
+            case OP_MODIFY_ELEMENT: {
+                uint8_t operation = READ_BYTE();
 
-                if (!IS_ARRAY(array)) {
-                    frame->ip = ip;
-                    runtimeError("Tanging koleksyon lamang ang maaaring tawagin gamit ang '[]'.");
+                frame->ip = ip;
+                if (!modifyElement(peek(2), peek(1), operation)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                if (!IS_NUMBER(index)) {
-                    frame->ip = ip;
-                    runtimeError("Inaasahan na makatanggap ng numero bilang indeks.");
+                Value value = pop();
+                vm.stackTop -= 2; // Array and index.
+                push(value);
+                break;
+            }
+            case OP_MODIFY_ELEMENT_2D: {
+                uint8_t operation = READ_BYTE();
+
+                frame->ip = ip;
+                if (!modifyElement2D(peek(3), peek(2), peek(1), operation)) {
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                AS_ARRAY(array)->elements.values[(int)AS_NUMBER(index)] = value;
-                push(value); // Leave the value on the stack.
+                Value value = pop();
+                vm.stackTop -= 3; // Array and both indexes.
+                push(value);
                 break;
-            } 
+            }
+            case OP_GET_CAPTURED: {
+                uint8_t slot = READ_BYTE();
+                push(frame->closure->upvalues[slot]);
+                break;
+            }
+            case OP_LONG_GET_CAPTURED: {
+                uint32_t slot = READ_LONG();
+                push(frame->closure->upvalues[slot]);
+                break;
+            }
             case OP_GET_UPVALUE: {
                 uint8_t slot = READ_BYTE();
-                push(*frame->closure->upvalues[slot]->location);
+                push(*AS_UPVALUE(frame->closure->upvalues[slot])->location);
+                break;
+            }
+            case OP_LONG_GET_UPVALUE: {
+                uint32_t slot = READ_LONG();
+                push(*AS_UPVALUE(frame->closure->upvalues[slot])->location);
                 break;
             }
             case OP_SET_UPVALUE: {
                 uint8_t slot = READ_BYTE();
-                *frame->closure->upvalues[slot]->location = peek(0);
+                *AS_UPVALUE(frame->closure->upvalues[slot])->location = peek(0);
+                break;
+            }
+            case OP_LONG_SET_UPVALUE: {
+                uint32_t slot = READ_LONG();
+                *AS_UPVALUE(frame->closure->upvalues[slot])->location = peek(0);
+                break;
+            }
+            case OP_INC_UPVALUE:
+            case OP_LONG_INC_UPVALUE: {
+                uint32_t slot = READ_SLOT(OP_INC_UPVALUE);
+                frame->ip = ip;
+                if (!step(AS_UPVALUE(frame->closure->upvalues[slot])->location, OP_ADD)) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
+            case OP_DEC_UPVALUE:
+            case OP_LONG_DEC_UPVALUE: {
+                uint32_t slot = READ_SLOT(OP_DEC_UPVALUE);
+                frame->ip = ip;
+                if (!step(AS_UPVALUE(frame->closure->upvalues[slot])->location,
+                          OP_SUBTRACT)) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
+            case OP_MODIFY_UPVALUE:
+            case OP_LONG_MODIFY_UPVALUE: {
+                uint32_t slot = READ_SLOT(OP_MODIFY_UPVALUE);
+                uint8_t operation = READ_BYTE();
+                frame->ip = ip;
+                if (!modify(AS_UPVALUE(frame->closure->upvalues[slot])->location,
+                            operation)) {
+                    return INTERPRET_RUNTIME_ERROR;
+                }
                 break;
             }
-            case OP_GET_PROPERTY: {
+            case OP_GET_PROPERTY:
+            case OP_LONG_GET_PROPERTY: {
                 if (!IS_INSTANCE(peek(0))) {
                     frame->ip = ip;
                     runtimeError("Tanging mga instansya lamang ang may mga katangian.");
@@ -594,7 +2755,7 @@ static InterpretResult run() {
                 }
 
                 ObjInstance* instance = AS_INSTANCE(peek(0));
-                ObjString* name = READ_STRING();
+                ObjString* name = READ_NAME(OP_GET_PROPERTY);
 
                 Value value;
                 if (tableGet(&instance->fields, name, &value)) {
@@ -608,7 +2769,8 @@ static InterpretResult run() {
                 }
                 break;
             }
-            case OP_SET_PROPERTY: {
+            case OP_SET_PROPERTY:
+            case OP_LONG_SET_PROPERTY: {
                 if (!IS_INSTANCE(peek(1))) {
                     frame->ip = ip;
                     runtimeError("Tanging mga instansya lamang ang may mga katangian.");
@@ -616,14 +2778,44 @@ static InterpretResult run() {
                 }
 
                 ObjInstance* instance = AS_INSTANCE(peek(1));
-                tableSet(&instance->fields, READ_STRING(), peek(0));
+                tableSet(&instance->fields, READ_NAME(OP_SET_PROPERTY), peek(0));
                 Value value = pop();
                 pop();
                 push(value);
                 break;
             }
-            case OP_GET_SUPER: {
-                ObjString* name = READ_STRING();
+            case OP_MODIFY_PROPERTY:
+            case OP_LONG_MODIFY_PROPERTY: {
+                ObjString* name = READ_NAME(OP_MODIFY_PROPERTY);
+                uint8_t operation = READ_BYTE();
+                frame->ip = ip;
+
+                if (!IS_INSTANCE(peek(1))) {
+                    runtimeError("Tanging mga instansya lamang ang may mga katangian.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                ObjInstance* instance = AS_INSTANCE(peek(1));
+                Value value;
+                if (!tableGet(&instance->fields, name, &value)) {
+                    runtimeError("Hindi kilala ang katangian '%s'.", name->chars);
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                Value operand = pop();
+                push(value);
+                push(operand);
+                if (!arithmetic(operation)) return INTERPRET_RUNTIME_ERROR;
+                tableSet(&instance->fields, name, peek(0));
+
+                value = pop();
+                pop(); // Instance.
+                push(value);
+                break;
+            }
+            case OP_GET_SUPER:
+            case OP_LONG_GET_SUPER: {
+                ObjString* name = READ_NAME(OP_GET_SUPER);
                 ObjClass* superclass = AS_CLASS(pop());
 
                 if (!bindMethod(superclass, name)) {
@@ -637,19 +2829,25 @@ static InterpretResult run() {
                 push(BOOL_VAL(valuesEqual(a, b)));
                 break;
             }
-            case OP_GREATER:    BINARY_OP(BOOL_VAL, >); break;
-            case OP_LESS:       BINARY_OP(BOOL_VAL, <); break;
+            case OP_GREATER:    BINARY_OP(BOOL_VAL, >, OP_GREATER_NUMBER); break;
+            case OP_LESS:       BINARY_OP(BOOL_VAL, <, OP_LESS_NUMBER); break;
             case OP_ADD: {
                 if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
-                    BINARY_OP(NUMBER_VAL, +); break;
-                } else if(!concatenate()) {
+                    BINARY_OP(NUMBER_VAL, +, OP_ADD_NUMBER); break;
+                }
+
+                if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
+                    quicken(frame, ip, OP_ADD_STRING);
+                }
+
+                if (!concatenate()) {
                     frame->ip = ip;
                     runtimeError("Hindi makabuo ng salita gamit.");
                     return INTERPRET_RUNTIME_ERROR;
 				}
                 break;
             }
-            case OP_SUBTRACT:   BINARY_OP(NUMBER_VAL, -); break;
+            case OP_SUBTRACT:   BINARY_OP(NUMBER_VAL, -, OP_SUBTRACT_NUMBER); break;
             case OP_MODULO: {
                 if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) {
                     frame->ip = ip;
@@ -661,7 +2859,7 @@ static InterpretResult run() {
                 push(NUMBER_VAL(a % b));
                 break;
             }
-            case OP_MULTIPLY:   BINARY_OP(NUMBER_VAL, *); break;
+            case OP_MULTIPLY:   BINARY_OP(NUMBER_VAL, *, OP_MULTIPLY_NUMBER); break;
             case OP_INT_DIVIDE: {
                 if (!IS_NUMBER(peek(0)) || !IS_NUMBER(peek(1))) {
                     frame->ip = ip;
@@ -673,7 +2871,56 @@ static InterpretResult run() {
                 push(NUMBER_VAL((int)(a / b)));
                 break;
             }
-            case OP_DIVIDE:     BINARY_OP(NUMBER_VAL, /); break;
+            case OP_DIVIDE:     BINARY_OP(NUMBER_VAL, /, OP_DIVIDE_NUMBER); break;
+            case OP_GREATER_NUMBER: NUMBER_OP(BOOL_VAL, >, OP_GREATER); break;
+            case OP_LESS_NUMBER:    NUMBER_OP(BOOL_VAL, <, OP_LESS); break;
+            case OP_ADD_NUMBER:     NUMBER_OP(NUMBER_VAL, +, OP_ADD); break;
+            case OP_ADD_STRING:
+                if (!IS_STRING(peek(0)) || !IS_STRING(peek(1))) {
+                    fallBack(frame, ip, OP_ADD);
+                    ip--;
+                    break;
+                }
+
+                concatenate();
+                break;
+            case OP_SUBTRACT_NUMBER: NUMBER_OP(NUMBER_VAL, -, OP_SUBTRACT); break;
+            case OP_MULTIPLY_NUMBER: NUMBER_OP(NUMBER_VAL, *, OP_MULTIPLY); break;
+            case OP_DIVIDE_NUMBER:  NUMBER_OP(NUMBER_VAL, /, OP_DIVIDE); break;
+            case OP_EQUAL_IMM: {
+                double b = READ_IMMEDIATE();
+                vm.stackTop[-1] = BOOL_VAL(IS_NUMBER(peek(0)) &&
+                                           AS_NUMBER(peek(0)) == b);
+                break;
+            }
+            case OP_GREATER_IMM:    IMMEDIATE_OP(BOOL_VAL, >); break;
+            case OP_LESS_IMM:       IMMEDIATE_OP(BOOL_VAL, <); break;
+            case OP_ADD_IMM: {
+                if (IS_NUMBER(peek(0))) {
+                    IMMEDIATE_OP(NUMBER_VAL, +); break;
+                }
+
+                push(NUMBER_VAL(READ_IMMEDIATE()));
+                if (!concatenate()) {
+                    frame->ip = ip;
+                    runtimeError("Hindi makabuo ng salita gamit.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                break;
+            }
+            case OP_SUBTRACT_IMM:   IMMEDIATE_OP(NUMBER_VAL, -); break;
+            case OP_MODULO_IMM: {
+                int b = READ_IMMEDIATE();
+                if (!IS_NUMBER(peek(0))) {
+                    frame->ip = ip;
+                    runtimeError("Inaasahang parehong numero ang gamit.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+                int a = AS_NUMBER(peek(0));
+                vm.stackTop[-1] = NUMBER_VAL(a % b);
+                break;
+            }
+            case OP_MULTIPLY_IMM:   IMMEDIATE_OP(NUMBER_VAL, *); break;
             case OP_NOT:
                 push(BOOL_VAL(isFalsey(pop())));
                 break;
@@ -687,7 +2934,35 @@ static InterpretResult run() {
                 break;
             case OP_PRINT: {
                 printValue(pop());
-                printf("\n");
+                writeChars("\n", 1);
+                if (vm.output.mode == OUTPUT_LINE) flushOutput();
+                break;
+            }
+            case OP_SWITCH:
+            case OP_LONG_SWITCH: {
+                uint32_t index = instruction == OP_SWITCH ?
+                    READ_BYTE() : READ_LONG();
+                Chunk* chunk = &frame->closure->function->chunk;
+                SwitchTable* table = &chunk->switches[index];
+                Value value = peek(0);
+                int offset = table->defaultOffset;
+
+                if (table->offsets != NULL) {
+                    if (IS_NUMBER(value)) {
+                        double slot = AS_NUMBER(value) - table->min;
+                        if (slot >= 0 && slot < table->offsetCount &&
+                            slot == (int)slot) {
+                            offset = table->offsets[(int)slot];
+                        }
+                    }
+                } else {
+                    Value target;
+                    if (valueTableGet(&table->cases, value, &target)) {
+                        offset = (int)AS_NUMBER(target);
+                    }
+                }
+
+                ip = chunk->code + offset;
                 break;
             }
             case OP_JUMP: {
@@ -695,28 +2970,145 @@ static InterpretResult run() {
                 ip += offset;
                 break;
             }
+            case OP_LONG_JUMP: {
+                uint32_t offset = READ_LONG();
+                ip += offset;
+                break;
+            }
             case OP_JUMP_IF_FALSE: {
                 uint16_t offset = READ_SHORT();
                 if (isFalsey(peek(0))) ip += offset;
                 break;
             }
+            case OP_LONG_JUMP_IF_FALSE: {
+                uint32_t offset = READ_LONG();
+                if (isFalsey(peek(0))) ip += offset;
+                break;
+            }
+            case OP_ITERATOR: {
+                // The type is checked once here instead of on every step.
+                Value collection = peek(0);
+                if (!IS_ARRAY(collection) && !IS_GRID(collection) &&
+                    !IS_MAP(collection) && !IS_SET(collection) &&
+                    !IS_DEQUE(collection) && !IS_STRING(collection) &&
+                    !IS_RANGE(collection)) {
+                    frame->ip = ip;
+                    runtimeError("Tanging koleksyon, diksyunaryo, kalipunan, pila, salita o saklaw lamang ang maaaring isa-isahin.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                push(NUMBER_VAL(0)); // Position of the next element.
+                break;
+            }
+            case OP_FOR_EACH:
+            case OP_LONG_FOR_EACH: {
+                uint32_t offset = instruction == OP_FOR_EACH ?
+                    READ_SHORT() : READ_LONG();
+                Obj* collection = AS_OBJ(peek(1));
+                int position = (int)AS_NUMBER(peek(0));
+
+                bool hasNext;
+                Value element = NULL_VAL;
+                if (objType(collection) == OBJ_ARRAY) {
+                    ValueArray* elements = &((ObjArray*)collection)->elements;
+                    hasNext = position < elements->count;
+                    if (hasNext) element = elements->values[position];
+                } else if (objType(collection) == OBJ_GRID) {
+                    ObjGrid* grid = (ObjGrid*)collection;
+                    hasNext = position < grid->sizes[0];
+                    if (hasNext && grid->dimensions == 1) {
+                        element = grid->values[position];
+                    } else if (hasNext) {
+                        element = OBJ_VAL(newGridView(grid, 1,
+                            position * grid->strides[0]));
+                    }
+                } else if (objType(collection) == OBJ_DEQUE) {
+                    ObjDeque* deque = (ObjDeque*)collection;
+                    hasNext = position < deque->count;
+                    if (hasNext) {
+                        element = deque->values[
+                            (deque->head + position) % deque->capacity];
+                    }
+                } else if (objType(collection) == OBJ_MAP ||
+                           objType(collection) == OBJ_SET) {
+                    // Goes through the keys, skipping empty entries.
+                    ValueTable* table = objType(collection) == OBJ_MAP ?
+                        &((ObjMap*)collection)->table :
+                        &((ObjSet*)collection)->table;
+                    while (position < table->capacity &&
+                           IS_NULL(table->entries[position].key)) {
+                        position++;
+                    }
+                    hasNext = position < table->capacity;
+                    if (hasNext) element = table->entries[position].key;
+                } else if (objType(collection) == OBJ_STRING) {
+                    ObjString* string = (ObjString*)collection;
+                    hasNext = position < string->length;
+                    if (hasNext) {
+                        element = OBJ_VAL(charString(string->chars[position]));
+                    }
+                } else {
+                    ObjRange* range = (ObjRange*)collection;
+                    double value = range->start + position;
+                    hasNext = value < range->end;
+                    element = NUMBER_VAL(value);
+                }
+
+                if (!hasNext) {
+                    ip += offset;
+                    break;
+                }
+
+                vm.stackTop[-1] = NUMBER_VAL(position + 1);
+                push(element);
+                break;
+            }
             case OP_LOOP: {
                 uint16_t offset = READ_SHORT();
                 ip -= offset;
                 break;
             }
-            case OP_CALL: {
+            case OP_LONG_LOOP: {
+                uint32_t offset = READ_LONG();
+                ip -= offset;
+                break;
+            }
+            case OP_CALL:
+            case OP_LONG_CALL: {
                 int argCount = READ_BYTE();
+                CallCache* cache = &frame->closure->function->chunk.calls[
+                    READ_SLOT(OP_CALL)];
+                Value callee = peek(argCount);
                 frame->ip = ip;
-                if (!callValue(peek(argCount), argCount)) {
-                    return INTERPRET_RUNTIME_ERROR;
+
+                // The same callee as last time already passed the checks.
+                if (IS_OBJ(callee) && AS_OBJ(callee) == cache->callee) {
+                    if (OBJ_TYPE(callee) == OBJ_NATIVE) {
+                        if (!callNative((ObjNative*)AS_OBJ(callee), argCount)) {
+                            return INTERPRET_RUNTIME_ERROR;
+                        }
+                        break;
+                    }
+
+                    if (!enterFrame(AS_CLOSURE(callee), argCount)) {
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+                } else {
+                    if (!callValue(callee, argCount)) {
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+
+                    if (IS_CLOSURE(callee) || IS_NATIVE(callee)) {
+                        cache->callee = AS_OBJ(callee);
+                    }
                 }
                 frame = &vm.frames[vm.frameCount - 1];
                 ip = frame->ip;
                 break;
             }
-            case OP_INVOKE: {
-                ObjString* method = READ_STRING();
+            case OP_INVOKE:
+            case OP_LONG_INVOKE: {
+                ObjString* method = READ_NAME(OP_INVOKE);
                 int argCount = READ_BYTE();
                 frame->ip = ip;
                 if (!invoke(method, argCount)) {
@@ -726,8 +3118,9 @@ static InterpretResult run() {
                 ip = frame->ip;
                 break;
             }
-            case OP_SUPER_INVOKE: {
-                ObjString* method = READ_STRING();
+            case OP_SUPER_INVOKE:
+            case OP_LONG_SUPER_INVOKE: {
+                ObjString* method = READ_NAME(OP_SUPER_INVOKE);
                 int argCount = READ_BYTE();
                 ObjClass* superclass = AS_CLASS(pop());
                 frame->ip = ip;
@@ -738,16 +3131,21 @@ static InterpretResult run() {
                 ip = frame->ip;
                 break;
             }
-            case OP_CLOSURE: {
-                ObjFunction* function = AS_FUNCTION(READ_CONSTANT());
+            case OP_CLOSURE:
+            case OP_LONG_CLOSURE: {
+                bool isLong = instruction == OP_LONG_CLOSURE;
+                ObjFunction* function = AS_FUNCTION(isLong ?
+                    READ_LONG_CONSTANT() : READ_CONSTANT());
                 ObjClosure* closure = newClosure(function);
                 push(OBJ_VAL(closure));
                 for (int i = 0; i < closure->upvalueCount; i++) {
-                    uint8_t isLocal = READ_BYTE();
-                    uint8_t index = READ_BYTE();
-                    if (isLocal) {
+                    uint8_t flags = READ_BYTE();
+                    uint32_t index = isLong ? READ_LONG() : READ_BYTE();
+                    if (flags == (UPVALUE_LOCAL | UPVALUE_VALUE)) {
+                        closure->upvalues[i] = frame->slots[index];
+                    } else if (flags & UPVALUE_LOCAL) {
                         closure->upvalues[i] =
-                            captureUpvalue(frame->slots + index);
+                            OBJ_VAL(captureUpvalue(frame->slots + index));
                     } else {
                         closure->upvalues[i] = frame->closure->upvalues[index];
                     }
@@ -769,12 +3167,15 @@ static InterpretResult run() {
 
                 vm.stackTop = frame->slots;
                 push(result);
+                if (vm.frameCount == baseFrame) return INTERPRET_OK;
+
                 frame = &vm.frames[vm.frameCount - 1];
                 ip = frame->ip;
                 break;
             }
             case OP_CLASS:
-                push(OBJ_VAL(newClass(READ_STRING())));
+            case OP_LONG_CLASS:
+                push(OBJ_VAL(newClass(READ_NAME(OP_CLASS))));
                 break;
             case OP_INHERIT: {
                 Value superclass = peek(1);
@@ -791,20 +3192,29 @@ static InterpretResult run() {
                 break;
             }
             case OP_METHOD:
-                defineMethod(READ_STRING());
+            case OP_LONG_METHOD:
+                defineMethod(READ_NAME(OP_METHOD));
                 break;
         }
     }
 
 #undef READ_BYTE
 #undef READ_SHORT
+#undef READ_IMMEDIATE
+#undef READ_LONG
 #undef READ_CONSTANT
+#undef READ_LONG_CONSTANT
 #undef READ_STRING
+#undef READ_LONG_STRING
+#undef READ_NAME
+#undef READ_SLOT
 #undef BINARY_OP
+#undef NUMBER_OP
+#undef IMMEDIATE_OP
 }
 
-InterpretResult interpret(const char* source) {
-    ObjFunction* function = compile(source);
+InterpretResult interpret(const char* source, bool compileLazily) {
+    ObjFunction* function = compile(source, compileLazily);
     if (function == NULL) return INTERPRET_COMPILE_ERROR;
 
     push(OBJ_VAL(function));
@@ -813,5 +3223,55 @@ InterpretResult interpret(const char* source) {
     push(OBJ_VAL(closure));
     call(closure, 0);
 
-    return run();
+    InterpretResult result = run(0);
+    flushOutput();
+    return result;
+}
+
+void writeOutput(const char* format, ...) {
+    Output* output = &vm.output;
+    int available = output->capacity - output->length;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(output->chars + output->length, available,
+                           format, args);
+    va_end(args);
+
+    if (length < available) {
+        output->length += length;
+        return;
+    }
+
+    // It did not fit, so make room and write it again.
+    flushOutput();
+    va_start(args, format);
+    if (length < output->capacity) {
+        output->length = vsnprintf(output->chars, output->capacity,
+                                   format, args);
+    } else {
+        vfprintf(stdout, format, args);
+    }
+    va_end(args);
+}
+
+// Same as writeOutput("%.*s", ...) without going through the format.
+void writeChars(const char* chars, int length) {
+    Output* output = &vm.output;
+    if (output->capacity - output->length < length) {
+        flushOutput();
+        if (length > output->capacity) {
+            fwrite(chars, 1, length, stdout);
+            return;
+        }
+    }
+
+    memcpy(output->chars + output->length, chars, length);
+    output->length += length;
+}
+
+void flushOutput() {
+    fwrite(vm.output.chars, 1, vm.output.length, stdout);
+    vm.output.length = 0;
+    fflush(stdout);
 }
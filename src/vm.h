@@ -14,6 +14,21 @@ typedef struct {
     Value* slots;
 } CallFrame;
 
+typedef enum {
+    OUTPUT_LINE,            // Written after every 'ipakita'.
+    OUTPUT_FULL,            // Written only once the buffer is full.
+} OutputMode;
+
+// What 'ipakita' prints is gathered here and written to stdout in bulk.
+// It is always written before an error is reported and when a script
+// ends, whatever the mode.
+typedef struct {
+    char* chars;
+    int length;
+    int capacity;
+    OutputMode mode;
+} Output;
+
 typedef struct {
     CallFrame frames[FRAMES_MAX];
     int frameCount;
@@ -23,6 +38,7 @@ typedef struct {
     Table globals;
     Table strings;
     ObjString* initString;
+    ObjString* charStrings[UINT8_COUNT];
     ObjUpvalue* openUpvalues;
 
     size_t bytesAllocated;
@@ -32,6 +48,8 @@ typedef struct {
     int grayCapacity;
     Obj** grayStack;
     bool markValue;
+
+    Output output;
 } VM;
 
 typedef enum {
@@ -46,6 +64,9 @@ void initVM();
 void freeVM();
 void push(Value value);
 Value pop();
-InterpretResult interpret(const char* source);
+InterpretResult interpret(const char* source, bool compileLazily);
+void writeOutput(const char* format, ...);
+void writeChars(const char* chars, int length);
+void flushOutput();
 
 #endif